@@ -1,6 +1,11 @@
 #include "source/solver.h"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <memory>
 #include <cassert>
 #include <cstring>
 #include "include/gflags/gflags.h"
@@ -20,10 +25,11 @@ DEFINE_double(pp_tol, 1.0, "A parameter to aggressiveness of Bunch-Kaufman pivot
 		"BKP in a continuous manner.");
 
 DEFINE_string(pivot, "rook", "Determines what kind of pivoting algorithm will be used"
-		" during the factorization. Choices are 'rook' and 'bunch'. The default is 'rook'.");
+		" during the factorization. Choices are 'rook', 'bunch' and 'static'. Static pivoting"
+		" never swaps rows or columns and perturbs tiny pivots instead. The default is 'rook'.");
 
 DEFINE_string(reordering, "amd", "Determines what sort of preordering will be used"
-		" on the matrix. Choices are 'amd', 'rcm', and 'none'.");
+		" on the matrix. Choices are 'amd', 'par_amd' (experimental multithreaded AMD, so far not faster than 'amd'), 'rcm', and 'none'.");
 
 DEFINE_string(equil, "bunch", "Decides if the matrix should be equilibriated before factoring is done. "
 		"Options are 'bunch' and 'none'. If the option is 'bunch', the matrix is equilibrated "
@@ -48,12 +54,302 @@ DEFINE_int32(max_iters, -1, "If >= 0 and supplied with a right hand side, SYM-IL
 
 DEFINE_string(solver, "sqmr", "The solver used if supplied a right-hand side. The "
 		"solution will be written to output_matrices/ in matrix-market "
-		"format. Choices are 'sqmr', 'minres', and 'full'");
+		"format. Choices are 'sqmr', 'minres', 'gmres', 'fgmres' and 'full'");
 
 DEFINE_double(solver_tol, 1e-6, "A tolerance for the iterative solver used. When the iterate x satisfies ||Ax-b||/||b|| < solver_tol, the solver is terminated. Has no effect when doing a full solve.");
 
+DEFINE_bool(pipelined, false, "If yes, uses the pipelined variants of SQMR and MINRES, which need only one "
+		"global reduction per iteration.");
+
+DEFINE_bool(csr, false, "If yes, A is converted to a compressed sparse row copy after the factorization, which the "
+		"iterative solver multiplies with (threaded and vectorised), and the list-of-lists storage of A is freed.");
+
+DEFINE_int32(restart, 30, "The restart length of GMRES and FGMRES.");
+
+DEFINE_bool(reorth, false, "If yes, GMRES and FGMRES orthogonalise every new basis vector twice.");
+
+DEFINE_int32(check_every, 1, "SQMR checks for convergence only every check_every iterations.");
+
+DEFINE_int32(refine, -1, "The maximum number of steps of iterative refinement done after a full solve. "
+		"The default (-1) does 3 steps with static pivoting, 10 with mixed precision and none otherwise.");
+
+DEFINE_bool(mixed, false, "If yes, full solves factor the matrix in single precision and refine the solution "
+		"to double precision accuracy with iterative refinement.");
+
+DEFINE_int32(shift_tries, 0, "If > 0, a factorization that breaks down (large entries in L or perturbed pivots) is redone "
+		"on A + alpha*I, for alpha = shift, 10*shift, ..., up to this many times.");
+
+DEFINE_double(shift, 1e-3, "The first diagonal shift tried by -shift_tries.");
+
+DEFINE_double(mem_budget, 0, "If > 0, the storage of the factors is kept within this many megabytes, by allowing "
+		"less fill in the later columns once the budget starts running out. A budget too small for the factors "
+		"without any fill is exceeded, with a warning.");
+
+DEFINE_string(ooc_file, "", "If not empty, L is kept out of core: its finished columns are evicted to this file "
+		"during the factorization and streamed back in by the solves.");
+
+DEFINE_double(ooc_window, 0, "The number of megabytes of finished columns of L kept in memory with -ooc_file.");
+
+DEFINE_string(checkpoint_file, "", "If not empty, the factorization saves its state to this file every "
+		"-checkpoint_interval seconds, and a run that finds a checkpoint of the same factorization resumes from it.");
+
+DEFINE_double(checkpoint_interval, 600, "The number of seconds between two checkpoints with -checkpoint_file.");
+
+DEFINE_int32(max_neg, -1, "If >= 0, the factorization stops as soon as it has more than this many negative pivots.");
+
+DEFINE_bool(inertia, false, "If yes, prints the inertia of the factorization and log|det(A)|.");
+
+DEFINE_bool(inv_diag, false, "If yes, computes the diagonal of the inverse of the factorization by selected "
+		"inversion and saves it to output_matrices/outinvdiag.mtx. This is diag(A^(-1)) only for an exact factorization, "
+		"so use -solver=full to get diag(A^(-1)); with the default incomplete factorization it only approximates it.");
+
+DEFINE_string(batch, "", "The filename of a manifest of matrices to factor concurrently (instead of -filename). "
+		"Each line holds a matrix and, optionally, a right hand side to solve for. A summary line is printed per matrix, "
+		"and with -save, the solutions are saved to output_matrices/outsol<i>.mtx.");
+
+DEFINE_int32(threads, 0, "The number of threads used by -batch (0 for all available).");
+
+DEFINE_bool(pipeline, false, "If yes, -batch factors the matrices one at a time, while the next matrices are loaded and "
+		"the factors of the previous ones are saved on background threads. With -save, the factors of the i-th "
+		"matrix are saved to output_matrices/out<i>_{B,L,D,P,S}.mtx.");
+
+DEFINE_int32(queue_depth, 2, "The number of matrices -pipeline lets the loading run ahead of the factorization, "
+		"and the factorization run ahead of the saving (this caps the number of matrices held in memory).");
+
 DEFINE_string(rhs_file, "", "The filename of the right hand side (in matrix-market format).");
 
+DEFINE_string(guess_file, "", "The filename of an initial guess for the iterative solver (in matrix-market format).");
+
+/*! \brief Sets the options given on the command line (other than the matrix and right hand side) in a solver.
+*/
+void set_options(symildl::solver<double>& solv) {
+	//default reordering scheme is AMD
+	solv.set_reorder_scheme(FLAGS_reordering.c_str());
+
+	//default is equil on
+	solv.set_equil(FLAGS_equil.c_str()); 
+
+	//default solver is SQMR
+	solv.set_solver(FLAGS_solver.c_str());
+
+	solv.set_pivot(FLAGS_pivot.c_str());
+	solv.set_refinement(FLAGS_refine);
+	solv.set_mixed_precision(FLAGS_mixed);
+	solv.set_pipelined(FLAGS_pipelined);
+	solv.set_csr_spmv(FLAGS_csr);
+	solv.set_convergence_check(FLAGS_check_every);
+	solv.set_gmres(FLAGS_restart, FLAGS_reorth);
+	solv.set_inplace(FLAGS_inplace);
+	solv.set_inertia_limit(FLAGS_max_neg);
+	solv.set_memory_budget((size_t) (FLAGS_mem_budget*1048576));
+	solv.set_out_of_core(FLAGS_ooc_file, (size_t) (FLAGS_ooc_window*1048576));
+	solv.set_checkpoint(FLAGS_checkpoint_file, FLAGS_checkpoint_interval);
+	solv.set_adaptive_shift(FLAGS_shift_tries, FLAGS_shift);
+}
+
+/*! \brief Reads the manifest given by -batch: one matrix per line, optionally followed by its right hand side. Blank lines and lines starting with % or # are skipped.
+*/
+bool read_manifest(vector<std::string>& mat_files, vector<std::string>& rhs_files) {
+	std::ifstream manifest(FLAGS_batch.c_str());
+	if (!manifest) {
+		std::cerr << "Could not open the manifest " << FLAGS_batch << "." << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(manifest, line)) {
+		std::istringstream tokens(line);
+		std::string mat_file, rhs_file;
+		if (!(tokens >> mat_file) || mat_file[0] == '%' || mat_file[0] == '#') continue;
+		tokens >> rhs_file;
+		mat_files.push_back(mat_file);
+		rhs_files.push_back(rhs_file);
+	}
+	return true;
+}
+
+/*! \brief Loads the i-th matrix of a batch (and its right hand side) into a quiet solver with the command line options set.
+	\return True if the matrix could be loaded.
+*/
+bool load_batch_entry(int i, const std::string& mat_file, const std::string& rhs_file, bool any_rhs, symildl::solver<double>& solv, vector<double>& b) {
+	solv.set_message_level("none");
+	bool ok = solv.A.load(mat_file);
+	set_options(solv);
+	solv.set_solver_params(FLAGS_max_iters, FLAGS_solver_tol);
+
+	//the factorizations of a batch are alive at the same time, so they need
+	//files of their own
+	const std::string suffix = "." + std::to_string(i);
+	if (!FLAGS_ooc_file.empty()) solv.set_out_of_core(FLAGS_ooc_file + suffix, (size_t) (FLAGS_ooc_window*1048576));
+	if (!FLAGS_checkpoint_file.empty()) solv.set_checkpoint(FLAGS_checkpoint_file + suffix, FLAGS_checkpoint_interval);
+	
+	const int dim = solv.A.n_cols();
+	if (!rhs_file.empty()) {
+		symildl::read_vector(b, rhs_file, symildl::message_level::NONE);
+	} else if (any_rhs) {
+		// for testing purposes only
+		b.assign(dim, 1);
+	}
+	if ((int) b.size() != dim || FLAGS_inplace) b.clear();
+	return (ok && dim > 0);
+}
+
+/*! \brief Prints the summary line of the i-th matrix of a batch.
+*/
+void print_batch_entry(int i, const std::string& mat_file, bool rhs_given, const symildl::solver<double>& solv, const vector<double>& b) {
+	std::string status = (solv.stopped_early() ? "stopped early" : (solv.A.num_perturbed > 0 ? "perturbed pivots" : "ok"));
+	if (rhs_given && b.empty()) status += ", right hand side not used";
+	printf("%d\t%s\tn = %d\tnnz(L) = %d\t%s\n", i, mat_file.c_str(), solv.A.n_cols(), (FLAGS_inplace ? solv.A.nnz() : solv.L.nnz()), status.c_str());
+}
+
+/*! \brief Factors (and solves with) all of the matrices in the manifest given by -batch, on a pool of threads.
+*/
+int run_batch() {
+	vector<std::string> mat_files, rhs_files;
+	if (!read_manifest(mat_files, rhs_files)) return 1;
+
+	const int n = mat_files.size();
+	const int threads = symildl::batch_threads(FLAGS_threads);
+	bool any_rhs = (FLAGS_max_iters > 0);
+	for (int i = 0; i < n; i++) any_rhs = any_rhs || !rhs_files[i].empty();
+	if (any_rhs && FLAGS_max_iters <= 0) FLAGS_max_iters = 200;
+
+	auto start = std::chrono::steady_clock::now();
+
+	//loading is a large part of the work for small matrices, so it is done
+	//concurrently as well
+	vector< symildl::solver<double> > solvers(n);
+	vector< vector<double> > b(n), x;
+	vector<char> loaded(n, 0);
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+	for (int i = 0; i < n; i++) {
+		loaded[i] = load_batch_entry(i, mat_files[i], rhs_files[i], any_rhs, solvers[i], b[i]);
+	}
+
+	//matrices that could not be loaded are left out of the batch
+	vector< symildl::solver<double> > batch;
+	vector< vector<double> > batch_b;
+	vector<int> batch_idx(n, -1);
+	for (int i = 0; i < n; i++) {
+		if (!loaded[i]) continue;
+		batch_idx[i] = batch.size();
+		batch.push_back(std::move(solvers[i]));
+		batch_b.push_back(std::move(b[i]));
+	}
+	solvers.clear();
+
+	if (!symildl::factor_batch(batch, FLAGS_fill, FLAGS_tol, FLAGS_pp_tol, threads)) return 1;
+	auto factored = std::chrono::steady_clock::now();
+	symildl::solve_batch(batch, batch_b, x, threads);
+	auto solved = std::chrono::steady_clock::now();
+
+	int num_failed = 0;
+	for (int i = 0; i < n; i++) {
+		const int j = batch_idx[i];
+		if (j < 0) {
+			printf("%d\t%s\tcould not be loaded\n", i, mat_files[i].c_str());
+			num_failed++;
+			continue;
+		}
+
+		print_batch_entry(i, mat_files[i], !rhs_files[i].empty(), batch[j], batch_b[j]);
+		if (FLAGS_save && !x[j].empty()) {
+			symildl::save_vector(x[j], "output_matrices/outsol" + std::to_string(i) + ".mtx");
+		}
+	}
+
+	double t_factor = std::chrono::duration<double>(factored - start).count();
+	double t_solve = std::chrono::duration<double>(solved - factored).count();
+	printf("Batch of %d matrices on %d threads:\t%.3f seconds to load and factor, %.3f seconds to solve (%.1f matrices per second).\n",
+		n - num_failed, threads, t_factor, t_solve, (n - num_failed)/std::max(t_factor + t_solve, 1e-9));
+	return (num_failed > 0 ? 1 : 0);
+}
+
+/*! \brief A matrix of a pipelined batch, as it is handed from one stage to the next.
+*/
+struct pipeline_job {
+	int i;	///<The position of the matrix in the manifest.
+	bool loaded;	///<True if the matrix could be loaded.
+	symildl::solver<double> solv;	///<The solver holding the matrix and, once factored, its factors.
+	vector<double> b;	///<The right hand side (empty if there is none).
+	vector<double> x;	///<The solution.
+};
+
+/*! \brief Factors (and solves with) all of the matrices in the manifest given by -batch one at a time, while a loader thread reads the next matrices and a saver thread writes out the factors of the previous ones. The two queues between the stages hold at most -queue_depth matrices each.
+*/
+int run_pipeline() {
+	vector<std::string> mat_files, rhs_files;
+	if (!read_manifest(mat_files, rhs_files)) return 1;
+
+	const int n = mat_files.size();
+	bool any_rhs = (FLAGS_max_iters > 0);
+	for (int i = 0; i < n; i++) any_rhs = any_rhs || !rhs_files[i].empty();
+	if (any_rhs && FLAGS_max_iters <= 0) FLAGS_max_iters = 200;
+
+	typedef std::unique_ptr<pipeline_job> job_ptr;
+	symildl::pipeline_queue<job_ptr> to_factor(FLAGS_queue_depth), to_save(FLAGS_queue_depth);
+	double t_load = 0, t_factor = 0, t_save = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	std::thread loader([&] {
+		for (int i = 0; i < n; i++) {
+			auto t0 = std::chrono::steady_clock::now();
+			job_ptr job(new pipeline_job());
+			job->i = i;
+			job->loaded = load_batch_entry(i, mat_files[i], rhs_files[i], any_rhs, job->solv, job->b);
+			t_load += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			to_factor.push(std::move(job));
+		}
+		to_factor.close();
+	});
+
+	std::thread saver([&] {
+		job_ptr job;
+		while (to_save.pop(job)) {
+			auto t0 = std::chrono::steady_clock::now();
+			if (FLAGS_save) {
+				job->solv.save("output_matrices/out" + std::to_string(job->i) + "_");
+				if (!job->x.empty()) symildl::save_vector(job->x, "output_matrices/outsol" + std::to_string(job->i) + ".mtx");
+			}
+			job.reset();
+			t_save += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		}
+	});
+
+	//the factorizations run one after another on this thread, reusing one set
+	//of work vectors
+	int num_failed = 0;
+	ildl_workspace<double> fws;
+	symildl::solver_workspace<double> ws;
+	job_ptr job;
+	while (to_factor.pop(job)) {
+		if (!job->loaded) {
+			printf("%d\t%s\tcould not be loaded\n", job->i, mat_files[job->i].c_str());
+			num_failed++;
+			continue;
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		job->solv.factor(FLAGS_fill, FLAGS_tol, FLAGS_pp_tol, &fws);
+		if (!job->b.empty()) {
+			job->x.resize(job->b.size());
+			job->solv.solve(job->b, job->x, ws);
+		}
+		t_factor += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+		print_batch_entry(job->i, mat_files[job->i], !rhs_files[job->i].empty(), job->solv, job->b);
+		to_save.push(std::move(job));
+	}
+	to_save.close();
+	loader.join();
+	saver.join();
+
+	double t_total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Pipeline of %d matrices:\t%.3f seconds (%.3f to load, %.3f to factor and solve, %.3f to save; %.1f matrices per second).\n",
+		n - num_failed, t_total, t_load, t_factor, t_save, (n - num_failed)/std::max(t_total, 1e-9));
+	return (num_failed > 0 ? 1 : 0);
+}
+
 int main(int argc, char* argv[])
 {
 	std::string usage("Performs an incomplete LDL factorization of a given matrix.\n"
@@ -66,6 +362,10 @@ int main(int argc, char* argv[])
 	google::SetUsageMessage(usage);
 	google::ParseCommandLineFlags(&argc, &argv, true);
 
+	if (!FLAGS_batch.empty()) {
+		return (FLAGS_pipeline ? run_pipeline() : run_batch());
+	}
+
 	if (FLAGS_filename.empty()) {
 		std::cerr << "No file specified! Type ./ldl_driver --help for a description of the program parameters." << std::endl;
 		return 0;
@@ -79,14 +379,6 @@ int main(int argc, char* argv[])
 	//load matrix
 	solv.load(FLAGS_filename);
 
-	//default reordering scheme is AMD
-	solv.set_reorder_scheme(FLAGS_reordering.c_str());
-
-	//default is equil on
-	solv.set_equil(FLAGS_equil.c_str()); 
-
-	//default solver is SQMR
-	solv.set_solver(FLAGS_solver.c_str());
 	if (FLAGS_max_iters > 0 || !FLAGS_rhs_file.empty()) {
 		if (FLAGS_max_iters <= 0) {
 			printf("Using SQMR (200 max iterations) as default solver since RHS was loaded.\n");
@@ -106,16 +398,41 @@ int main(int argc, char* argv[])
 			return 1;
 		}
 		solv.set_rhs(rhs);
+
+		if (!FLAGS_guess_file.empty()) {
+			vector<double> x0;
+			symildl::read_vector(x0, FLAGS_guess_file);
+			if ((int) x0.size() != solv.A.n_cols()) {
+				std::cout << "The initial guess dimensions do not match the dimensions of A." << std::endl;
+				return 1;
+			}
+			solv.set_initial_guess(x0);
+		}
 	}
 
-	solv.set_pivot(FLAGS_pivot.c_str());
-	solv.set_inplace(FLAGS_inplace);
+	set_options(solv);
 	solv.solve(FLAGS_fill, FLAGS_tol, FLAGS_pp_tol, FLAGS_max_iters, FLAGS_solver_tol);
 
 	if (FLAGS_save) {
 		solv.save();
 	}
 
+	if (FLAGS_inertia && !solv.stopped_early()) {
+		int npos, nneg, nzero, sign;
+		solv.inertia(npos, nneg, nzero);
+		double ld = solv.log_det(&sign);
+		printf("Inertia (+, -, 0):\t(%d, %d, %d)\n", npos, nneg, nzero);
+		printf("log|det(A)|:\t\t%e (sign %d)\n", ld, sign);
+	}
+
+	if (FLAGS_inv_diag) {
+		auto start = std::chrono::steady_clock::now();
+		vector<double> inv_diag;
+		solv.inverse_diagonal(inv_diag);
+		printf("Selected inversion:\t%.3f seconds.\n", symildl::seconds_since(start));
+		symildl::save_vector(inv_diag, "output_matrices/outinvdiag.mtx");
+	}
+
 #ifdef SYM_ILDL_DEBUG
 	if (FLAGS_display) {
 		solv.display();
@@ -0,0 +1,130 @@
+// -*- mode: c++ -*-
+#ifndef _BFS_STRUCT_H_
+#define _BFS_STRUCT_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*!	\brief A structure containing the workspace used by the breadth-first searches in sym_rcm() and find_root().
+
+	Node degrees are computed once up front, and the visited and frontier sets are kept as bitmaps. This lets each level be expanded either top-down (scanning the neighbours of the frontier) or bottom-up (scanning the unvisited nodes for a neighbour in the frontier), whichever touches fewer edges. See "Direction-Optimizing Breadth-First Search" by Beamer, Asanovic and Patterson (2012).
+*/
+class bfs_struct
+{
+	public:
+		typedef unsigned long long word_type;
+
+		vector<int> deg;	///<deg[i] is the number of off-diagonal non-zeros in row/col i.
+		vector<word_type> visited;	///<Bitmap of all nodes visited so far.
+		vector<word_type> frontier;	///<Bitmap of the nodes in lvl_set (only filled during a bottom-up step).
+
+		vector<int> lvl_set;	///<The current level set.
+		vector<int> new_set;	///<Storage for the next level set (swapped with lvl_set after each step).
+		vector<int> reached;	///<Every node visited by the current search, so that the search can be undone cheaply.
+		vector< vector<int> > local;	///<Per-thread buffers for the next level set.
+
+		long long unvisited_edges;	///<Sum of deg over all unvisited nodes. Used by the direction heuristic.
+		bool bottom_up;	///<True if the last level was expanded bottom-up.
+
+		/*!	\brief Allocates space for a graph with n nodes. deg must be filled in separately.
+		*/
+		void resize(int n) {
+			int words = (n + 63)/64;
+			deg.assign(n, 0);
+			visited.assign(words, 0);
+			frontier.assign(words, 0);
+
+			lvl_set.clear(); lvl_set.reserve(n);
+			new_set.clear(); new_set.reserve(n);
+			reached.clear(); reached.reserve(n);
+
+			local.resize(num_threads());
+			unvisited_edges = 0;
+			bottom_up = false;
+		}
+
+		/*!	\return The number of threads used in each level expansion.
+		*/
+		static int num_threads() {
+#ifdef _OPENMP
+			return omp_get_max_threads();
+#else
+			return 1;
+#endif
+		}
+
+		/*!	\return The id of the calling thread.
+		*/
+		static int thread_id() {
+#ifdef _OPENMP
+			return omp_get_thread_num();
+#else
+			return 0;
+#endif
+		}
+
+		/*!	\return True if bit i is set in bits.
+		*/
+		static bool test(const vector<word_type>& bits, int i) {
+			return (bits[i >> 6] >> (i & 63)) & 1;
+		}
+
+		/*!	\brief Sets bit i in bits (not thread safe).
+		*/
+		static void set(vector<word_type>& bits, int i) {
+			bits[i >> 6] |= word_type(1) << (i & 63);
+		}
+
+		/*!	\brief Clears bit i in bits (not thread safe).
+		*/
+		static void reset(vector<word_type>& bits, int i) {
+			bits[i >> 6] &= ~(word_type(1) << (i & 63));
+		}
+
+		/*!	\brief Atomically marks node i as visited.
+			\return True if this call was the one that visited i.
+		*/
+		bool claim(int i) {
+			word_type mask = word_type(1) << (i & 63), old;
+			word_type& w = visited[i >> 6];
+#ifdef _OPENMP
+			//cheap check before the atomic update. other threads may be setting bits
+			//of the same word, so it is read atomically as well.
+			#pragma omp atomic read
+			old = w;
+			if (old & mask) return false;
+			#pragma omp atomic capture
+			{ old = w; w |= mask; }
+#else
+			if (w & mask) return false;
+			old = w; w |= mask;
+#endif
+			return !(old & mask);
+		}
+
+		/*!	\brief Starts a new search rooted at node s.
+		*/
+		void start(int s) {
+			lvl_set.clear();
+			reached.clear();
+			bottom_up = false;
+
+			set(visited, s);
+			unvisited_edges -= deg[s];
+			lvl_set.push_back(s);
+			reached.push_back(s);
+		}
+
+		/*!	\brief Undoes the last search, marking every node it reached as unvisited.
+		*/
+		void undo() {
+			for (vector<int>::iterator it = reached.begin(); it != reached.end(); it++) {
+				reset(visited, *it);
+				unvisited_edges += deg[*it];
+			}
+			reached.clear();
+		}
+};
+
+#endif
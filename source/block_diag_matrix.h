@@ -11,6 +11,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include "mtx_text.h"
+
 #ifdef SYM_ILDL_DEBUG
 template<class el_type>
 std::ostream& operator<< (std::ostream& os, const std::vector<el_type>& vec)
@@ -109,7 +111,14 @@ public:
 	}
 	
 	/*!	\param i the index of the element.
-		\return The D(i+1,i)th element.
+		\return The D(i,i)th element.
+	*/
+	const el_type& operator[](int i) const {
+		return main_diag.at(i);
+	}
+	
+	/*!	\param i the index of the element.
+		\return A reference to the D(i+1,i)th element. The element is created (as a 0) if it is not already stored, so this is only for filling in the matrix.
 	*/
 	el_type& off_diagonal(int i) {
 		if (!off_diag.count(i)) {
@@ -120,6 +129,14 @@ public:
 		return off_diag[i];
 	}
 	
+	/*!	\param i the index of the element.
+		\return The D(i+1,i)th element, or 0 if it is not stored. Never modifies the matrix.
+	*/
+	el_type off_diagonal(int i) const {
+		typename int_elt_map::const_iterator it = off_diag.find(i);
+		return (it == off_diag.end() ? 0 : it->second);
+	}
+	
 	/*!	\param i the index of the element.
 		\return 2 if there is a diagonal pivot at D(i,i) and D(i+1,i+1).
 				-2 if there is a diagonal pivot at D(i-1,i-1) and D(i,i).
@@ -135,12 +152,71 @@ public:
 		}
 	}
 	
+	/*!	\brief Adds the inertia of the block starting at D(i,i) to the counts given. A 2x2 block has one positive and one negative eigenvalue if its determinant is negative, and otherwise two eigenvalues with the sign of its trace.
+		\param i the index of the first row/col of the block.
+		\param npos the number of positive eigenvalues.
+		\param nneg the number of negative eigenvalues.
+		\param nzero the number of zero eigenvalues.
+		\return The size of the block.
+	*/
+	int block_inertia(int i, int& npos, int& nneg, int& nzero) const {
+		if (block_size(i) == 2) {
+			double a = main_diag[i], d = main_diag[i+1], c = off_diagonal(i);
+			double det = a*d - c*c;
+			if (det < 0) {
+				npos++; nneg++;
+			} else {
+				int& ns = (a + d > 0 ? npos : (a + d < 0 ? nneg : nzero));
+				ns += (det > 0 ? 2 : 1);
+				if (det == 0) nzero++;
+			}
+			return 2;
+		}
+		
+		if (main_diag[i] > 0) npos++;
+		else if (main_diag[i] < 0) nneg++;
+		else nzero++;
+		return 1;
+	}
+	
+	/*!	\brief Computes the inertia of this matrix (the numbers of positive, negative and zero eigenvalues) in one pass over its blocks. By Sylvester's law of inertia, this is also the inertia of LDL'.
+		\param npos the number of positive eigenvalues.
+		\param nneg the number of negative eigenvalues.
+		\param nzero the number of zero eigenvalues.
+	*/
+	void inertia(int& npos, int& nneg, int& nzero) const {
+		npos = nneg = nzero = 0;
+		for (int i = 0; i < m_n_size; ) {
+			i += block_inertia(i, npos, nneg, nzero);
+		}
+	}
+	
+	/*!	\brief Computes log|det(D)| in one pass over the blocks of this matrix.
+		\param sign if not NULL, the sign of det(D) is stored here (0 if D is singular).
+		\return log|det(D)|, or -inf if D is singular.
+	*/
+	double log_abs_det(int* sign = NULL) const {
+		double res = 0;
+		int sgn = 1;
+		for (int i = 0; i < m_n_size; i += block_size(i)) {
+			double det = main_diag[i];
+			if (block_size(i) == 2) {
+				det = main_diag[i]*main_diag[i+1] - off_diagonal(i)*off_diagonal(i);
+			}
+			if (det < 0) sgn = -sgn;
+			else if (det == 0) sgn = 0;
+			res += log(abs(det));
+		}
+		if (sign) *sign = sgn;
+		return res;
+	}
+	
 	/*!	\brief Solves the preconditioned problem |D| = Q|V|Q', where QVQ' is the eigendecomposition of D, and |.| is applied elementwise.
 		\param b the right hand side.
 		\param x a storage vector for the solution (must be same size as b).
         \param transposed solves |V|^(1/2)Q' if true, Q|V|^(1/2) if false.
 	*/
-	void sqrt_solve(const elt_vector_type& b, elt_vector_type& x, bool transposed = false) {
+	void sqrt_solve(const elt_vector_type& b, elt_vector_type& x, bool transposed = false) const {
 		assert(b.size() == x.size());
 		
 		const double eps = 1e-8;
@@ -150,7 +226,7 @@ public:
 			if (block_size(i) == 2) {
 				alpha = main_diag[i];
 				beta = main_diag[i+1];
-				gamma = off_diag[i];
+				gamma = off_diagonal(i);
 				
 				disc = sqrt((alpha-beta)*(alpha-beta) + 4*gamma*gamma);
 				eig0 = 0.5*(alpha+beta+disc);
@@ -196,7 +272,7 @@ public:
 		\param b the right hand side.
 		\param x a storage vector for the solution (must be same size as b).
 	*/
-	void solve(const elt_vector_type& b, elt_vector_type& x) {
+	void solve(const elt_vector_type& b, elt_vector_type& x) const {
 		assert(b.size() == x.size());
 		
 		double a, d, c, det;
@@ -204,7 +280,7 @@ public:
 			if (block_size(i) == 2) {
 				a = main_diag[i];
 				d = main_diag[i+1];
-				c = off_diag[i];
+				c = off_diagonal(i);
                 det = a*d - c*c;
 				// system is (a c; c d)
                 // inverse is 1/(ad - c^2) * (d -c; -c a)
@@ -216,6 +292,43 @@ public:
 		}
 	}
     
+	/*!	\brief Solves the system Dx = b in place for a sparse right hand side.
+		\param x on entry, the right hand side (zero outside of xi). On exit, the solution.
+		\param xi the nonzero pattern of b. The other index of each 2x2 block touched is appended to it.
+		\param marked a bitset of size n, which must be all false (it is left all false).
+	*/
+	void sparse_solve(elt_vector_type& x, std::vector<int>& xi, std::vector<bool>& marked) const {
+		const int nb = xi.size();
+		for (int t = 0; t < nb; t++) marked[xi[t]] = true;
+		for (int t = 0; t < nb; t++) {
+			int i = xi[t], bs = block_size(i);
+			if (bs == 1) continue;
+			int j = (bs == 2 ? i+1 : i-1);
+			if (!marked[j]) {
+				marked[j] = true;
+				xi.push_back(j);
+			}
+		}
+		
+		double a, d, c, det;
+		for (int t = 0; t < (int) xi.size(); t++) {
+			int i = xi[t];
+			marked[i] = false;
+			int bs = block_size(i);
+			if (bs == 2) {
+				a = main_diag[i];
+				d = main_diag[i+1];
+				c = off_diagonal(i);
+				det = a*d - c*c;
+				el_type b0 = x[i], b1 = x[i+1];
+				x[i] = (d*b0 - c*b1)/det;
+				x[i+1] = (-c*b0 + a*b1)/det;
+			} else if (bs == 1) {
+				x[i] = x[i]/main_diag[i];
+			}
+		}
+	}
+	
 	/*! \return A string reprepsentation of this matrix.
 	*/
 	std::string to_string () const;
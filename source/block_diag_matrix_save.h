@@ -9,27 +9,36 @@ bool block_diag_matrix<el_type> :: save(std::string filename) const
 	if(!out)
 	return false;
 
-	out.flags(std::ios_base::scientific);
-	out.precision(16);
 	std::string header;
 	
 	header= "%%MatrixMarket matrix coordinate ";
 	header += "real symmetric"; //maybe change later to have general/complex/blah as options
 
-	out << header << std::endl; 
+	out << header << "\n"; 
 	out << n_rows() << " " << n_cols() << " " << nnz() << "\n";
 
-	for(int i = 0; i < n_cols(); i++) {
-		out << i+1 << " " << i+1 << " " << main_diag[i] << "\n";
-		if (block_size(i) == 2) {
-			out << i+2 << " " << i+1 << " " << off_diag.find(i)->second << "\n";
-			out << i+2 << " " << i+2 << " " << main_diag[i+1] << "\n";
-			i++;
-		}
+	//the rows are cut into chunks of about mtx_chunk_entries rows each (never
+	//between the two rows of a 2x2 block), which are formatted in parallel
+	std::vector<int> first(1, 0);
+	for (int i = mtx_chunk_entries; i < n_cols(); i += mtx_chunk_entries) {
+		if (block_size(i) == -2) i++;
+		if (i < n_cols()) first.push_back(i);
 	}
+	if (n_cols() > 0) first.push_back(n_cols());
+
+	bool ok = mtx_write_chunks(out, first.size()-1, [&](int c, std::string& buf) {
+		for (int i = first[c]; i < first[c+1]; i++) {
+			mtx_put_entry(buf, i+1, i+1, main_diag[i]);
+			if (block_size(i) == 2) {
+				mtx_put_entry(buf, i+2, i+1, off_diag.find(i)->second);
+				mtx_put_entry(buf, i+2, i+2, main_diag[i+1]);
+				i++;
+			}
+		}
+	});
 	
 	out.close();
-	return true;
+	return ok && !out.fail();
 }
 
 #endif
@@ -0,0 +1,28 @@
+// -*- mode: c++ -*-
+#ifndef _CHECKPOINT_STRUCT_H_
+#define _CHECKPOINT_STRUCT_H_
+
+#include <vector>
+
+/*! \brief The loop state of ildl() saved in a checkpoint, besides the matrices themselves.
+
+	At the end of an iteration of ildl(), the work vectors are all zero again, so the factorization can be resumed from the matrices, the permutation, and the counters below.
+*/
+struct checkpoint_struct
+{
+	int k;	///<The next column to be factored.
+	int count;	///<The number of nonzeros stored in L so far.
+	int num_perturbed;	///<The number of pivots perturbed so far.
+	int num_pos_pivots;	///<The number of positive eigenvalues of D so far (only counted if max_neg_pivots >= 0).
+	int num_neg_pivots;	///<The number of negative eigenvalues of D so far (only counted if max_neg_pivots >= 0).
+	int num_zero_pivots;	///<The number of zero eigenvalues of D so far (only counted if max_neg_pivots >= 0).
+	double pivot_growth;	///<The largest entry of L so far.
+	unsigned long long bytes;	///<The storage tracked for the memory budget so far.
+	unsigned long long peak_bytes;	///<The largest storage tracked so far.
+	std::vector<int> col_count;	///<The storage reserved for each column of L.
+	std::vector<int> list_capacity;	///<The capacity of each row list of L, which the memory budget depends on.
+
+	checkpoint_struct() : k(0), count(0), num_perturbed(0), num_pos_pivots(0), num_neg_pivots(0), num_zero_pivots(0), pivot_growth(0), bytes(0), peak_bytes(0) {}
+};
+
+#endif
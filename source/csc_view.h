@@ -0,0 +1,66 @@
+// -*- mode: c++ -*-
+#ifndef _CSC_VIEW_H_
+#define _CSC_VIEW_H_
+
+/*!	\brief A read-only view of a symmetric matrix held by the caller in compressed sparse column (CSC) format.
+
+	Only the lower triangle is used, i.e. entries above the diagonal are skipped (as they are by lilc_matrix::load()). The view does not own or copy the arrays, which must stay alive and unchanged as long as it is used.
+*/
+template<class el_type>
+class csc_view
+{
+	public:
+		const int* ptr;	///<The column pointers (n+1 of them).
+		const int* row;	///<The row indices of the entries.
+		const el_type* val;	///<The values of the entries.
+		int n;	///<The dimension of the matrix.
+
+		/*! \brief Creates an empty view. */
+		csc_view() : ptr(NULL), row(NULL), val(NULL), n(0) {}
+
+		/*! \brief Creates a view of an n*n matrix in CSC format.
+			\param ptr_ the column pointers.
+			\param row_ the row indices.
+			\param val_ the values.
+			\param dim the dimension of the matrix.
+		*/
+		csc_view(const int* ptr_, const int* row_, const el_type* val_, int dim) : ptr(ptr_), row(row_), val(val_), n(dim) {}
+
+		/*! \return True if no matrix is viewed. */
+		bool empty() const {
+			return ptr == NULL;
+		}
+
+		/*! \return The number of entries stored in the arrays (both triangles, if both are stored). */
+		int stored() const {
+			return (ptr == NULL ? 0 : ptr[n]);
+		}
+
+		/*! \brief Performs a matrix-vector product with P'SASP, the permuted and equilibrated matrix the iterative solvers work with, without forming it.
+
+			\param x the vector to be multiplied.
+			\param y a storage vector for the result (must be same size as x).
+			\param iperm the inverse of the permutation P, i.e. row i of A is row iperm[i] of P'SASP.
+			\param s the diagonal of the equilibration S.
+		*/
+		void multiply(const vector<el_type>& x, vector<el_type>& y, const vector<int>& iperm, const vector<el_type>& s) const {
+			y.clear(); y.resize(x.size(), 0);
+			for (int j = 0; j < n; j++) {
+				const int pj = iperm[j];
+				const el_type xj = x[pj], sj = s[j];
+				el_type yj = 0;
+				for (int k = ptr[j]; k < ptr[j+1]; k++) {
+					const int i = row[k];
+					if (i < j) continue;
+
+					const el_type a = s[i]*val[k]*sj;
+					const int pi = iperm[i];
+					y[pi] += a*xj;
+					if (i != j) yj += a*x[pi];
+				}
+				y[pj] += yj;
+			}
+		}
+};
+
+#endif
@@ -0,0 +1,119 @@
+// -*- mode: c++ -*-
+#ifndef _CSR_MATRIX_H_
+#define _CSR_MATRIX_H_
+
+/*!	\brief A symmetric matrix stored in compressed sparse row (CSR) format with both of its halves, for fast matrix-vector products.
+
+	Unlike lilc_matrix::multiply(), which scatters each entry of the lower half into two places of the result, every row here is a contiguous gather (a dot product with x). The rows are independent, so the product is threaded over the rows and each row is vectorised. The matrix cannot be modified once built.
+*/
+template<class el_type>
+class csr_matrix
+{
+	public:
+		vector<int> row_ptr;	///<The start of each row in col and val (n+1 of them).
+		vector<int> col;	///<The column indices of the entries.
+		vector<el_type> val;	///<The values of the entries.
+		int n;	///<The dimension of the matrix.
+
+		/*! \brief Creates an empty matrix. */
+		csr_matrix() : n(0) {}
+
+		/*! \return True if nothing has been built. */
+		bool empty() const {
+			return row_ptr.empty();
+		}
+
+		/*! \return The number of entries stored (i.e. in both halves). */
+		int nnz() const {
+			return (row_ptr.empty() ? 0 : row_ptr[n]);
+		}
+
+		/*! \brief Releases all storage. */
+		void clear() {
+			vector<int>().swap(row_ptr);
+			vector<int>().swap(col);
+			vector<el_type>().swap(val);
+			n = 0;
+		}
+
+		/*! \brief Builds the matrix from its lower half, with two passes over the entries (one to count them, one to fill them in).
+			\param dim the dimension of the matrix.
+			\param for_each_entry a function that calls visit(i, j, v) for every entry v = A(i, j), i >= j, of the lower half, i.e. for_each_entry(visit).
+		*/
+		template<class entry_fn>
+		void build(int dim, entry_fn for_each_entry) {
+			n = dim;
+			row_ptr.assign(n+1, 0);
+			for_each_entry([&](int i, int j, el_type) {
+				row_ptr[i+1]++;
+				if (i != j) row_ptr[j+1]++;
+			});
+			for (int i = 0; i < n; i++) row_ptr[i+1] += row_ptr[i];
+
+			col.resize(row_ptr[n]);
+			val.resize(row_ptr[n]);
+			vector<int> next(row_ptr.begin(), row_ptr.end()-1);
+			for_each_entry([&](int i, int j, el_type v) {
+				col[next[i]] = j;
+				val[next[i]++] = v;
+				if (i != j) {
+					col[next[j]] = i;
+					val[next[j]++] = v;
+				}
+			});
+		}
+
+		/*! \brief Performs a matrix-vector product with this matrix.
+			\param x the vector to be multiplied.
+			\param y a storage vector for the result.
+		*/
+		void multiply(const vector<el_type>& x, vector<el_type>& y) const {
+			y.resize(n);
+			const int* p = row_ptr.data();
+			const int* c = col.data();
+			const el_type* v = val.data();
+			const el_type* xp = x.data();
+			#pragma omp parallel for schedule(static) if (nnz() > (1 << 16))
+			for (int i = 0; i < n; i++) {
+				el_type sum = 0;
+				#pragma omp simd reduction(+:sum)
+				for (int k = p[i]; k < p[i+1]; k++) {
+					sum += v[k]*xp[c[k]];
+				}
+				y[i] = sum;
+			}
+		}
+
+		/*! \brief Saves the lower half of the matrix in matrix market (.mtx) format, as a symmetric matrix.
+			\param filename the filename the matrix will be saved under.
+			\return True if the matrix was saved.
+		*/
+		bool save(std::string filename) const {
+			std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+			if (!out) return false;
+
+			// the lower half of column j is the part of row j right of the diagonal
+			int lower = 0;
+			for (int j = 0; j < n; j++) {
+				for (int k = row_ptr[j]; k < row_ptr[j+1]; k++) {
+					if (col[k] >= j) lower++;
+				}
+			}
+			out << "%%MatrixMarket matrix coordinate real symmetric\n";
+			out << n << " " << n << " " << lower << "\n";
+
+			const int chunk_rows = std::max(1, (int) ((long long) n*mtx_chunk_entries/std::max(nnz(), 1)));
+			bool ok = mtx_write_chunks(out, (n + chunk_rows - 1)/chunk_rows, [&](int c, std::string& buf) {
+				for (int j = c*chunk_rows; j < std::min(n, (c+1)*chunk_rows); j++) {
+					for (int k = row_ptr[j]; k < row_ptr[j+1]; k++) {
+						if (col[k] >= j) mtx_put_entry(buf, col[k]+1, j+1, val[k]);
+					}
+				}
+			});
+
+			out.close();
+			return ok && !out.fail();
+		}
+};
+
+#endif
@@ -0,0 +1,39 @@
+// -*- mode: c++ -*-
+#ifndef _ILDL_WORKSPACE_H_
+#define _ILDL_WORKSPACE_H_
+
+/*!	\brief A structure containing the temporary vectors used by ildl() and ildl_inplace().
+
+	Both functions leave the work vectors all zero (and in_set all false) when they return, so a workspace can be handed from one factorization to the next without clearing it. Factoring many small matrices in a row (or one per thread, see factor_batch()) then reuses the same storage instead of allocating it for every matrix.
+*/
+template<class el_type>
+class ildl_workspace
+{
+	typedef vector<int> idx_vector_type;
+	typedef vector<el_type> elt_vector_type;
+
+	public:
+		elt_vector_type work;	///<The current column (all zero between factorizations).
+		elt_vector_type temp;	///<The column it may be pivoted with (all zero between factorizations).
+		idx_vector_type curr_nnzs;	///<The nonzero indices of work.
+		idx_vector_type temp_nnzs;	///<The nonzero indices of temp.
+		vector<bool> in_set;	///<A bitset used for unsorted merges (all false between factorizations).
+		swap_struct<el_type> s;	///<The temporary variables used in pivoting.
+		idx_vector_type col_count;	///<The column counts of the factor (ildl() only).
+		idx_vector_type row_count;	///<The row counts of the factor (ildl() only).
+
+		/*!	\brief Makes room for factoring an n by n matrix. The storage only ever grows, and is never cleared.
+		*/
+		void resize(int n) {
+			if ((int) work.size() < n) {
+				work.resize(n, 0);
+				temp.resize(n, 0);
+				in_set.resize(n, false);
+			}
+			curr_nnzs.clear();
+			temp_nnzs.clear();
+			curr_nnzs.reserve(n); //reserves space for worse case (entire col is non-zero)
+		}
+};
+
+#endif
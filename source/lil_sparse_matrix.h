@@ -6,6 +6,7 @@
 #include <string>
 #include <fstream>
 #include <limits>
+#include <algorithm>
 
 
 using std::vector;
@@ -39,7 +40,9 @@ public:
 	lil_sparse_matrix (int n_rows, int n_cols) : m_n_rows(n_rows), m_n_cols (n_cols)
 	{
 		nnz_count = 0;
-		eps = 1e-8;
+		// in single precision, 1e-8 is below the rounding error of the updates,
+		// which can make the rook pivoting search cycle forever.
+		eps = std::max(1e-8, 10.0*std::numeric_limits<el_type>::epsilon());
 	}
 	
 	/*! \return Number of rows in the matrix. */
@@ -0,0 +1,241 @@
+// -*- mode: c++ -*-
+#ifndef _LILC_MATRIX_CHECKPOINT_H_
+#define _LILC_MATRIX_CHECKPOINT_H_
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+//a checkpoint is a raw binary dump, starting with this tag and sizeof(el_type)
+static const char checkpoint_magic[8] = {'S', 'Y', 'M', 'I', 'L', 'D', 'L', '2'};
+
+template <class T>
+inline void write_raw(std::ostream& out, const T& v) {
+	out.write((const char*) &v, sizeof(T));
+}
+
+template <class T>
+inline void read_raw(std::istream& in, T& v) {
+	in.read((char*) &v, sizeof(T));
+}
+
+template <class T>
+inline void write_vec(std::ostream& out, const vector<T>& v) {
+	long long n = v.size();
+	write_raw(out, n);
+	out.write((const char*) v.data(), n*sizeof(T));
+}
+
+template <class T>
+inline void read_vec(std::istream& in, vector<T>& v) {
+	long long n = -1;
+	read_raw(in, n);
+	if (!in || n < 0) {
+		in.setstate(std::ios::failbit);
+		return;
+	}
+	v.resize(n);
+	in.read((char*) v.data(), n*sizeof(T));
+}
+
+//a list of lists is stored as the list of lengths followed by all of the lists back to back
+template <class T>
+inline void write_vecs(std::ostream& out, const vector< vector<T> >& v) {
+	vector<int> len(v.size());
+	for (int i = 0; i < (int) v.size(); i++) len[i] = v[i].size();
+	write_vec(out, len);
+	for (int i = 0; i < (int) v.size(); i++) out.write((const char*) v[i].data(), len[i]*sizeof(T));
+}
+
+template <class T>
+inline void read_vecs(std::istream& in, vector< vector<T> >& v) {
+	vector<int> len;
+	read_vec(in, len);
+	v.resize(len.size());
+	for (int i = 0; i < (int) len.size() && in; i++) {
+		v[i].resize(len[i]);
+		in.read((char*) v[i].data(), len[i]*sizeof(T));
+	}
+}
+
+template <class el_type>
+unsigned long long lilc_matrix<el_type> :: fingerprint(int lfil, double tol, double pp_tol, int piv_type) const {
+	//FNV-1a over the parameters and the (equilibrated and permuted) matrix
+	unsigned long long h = 14695981039346656037ULL;
+	auto mix = [&](const void* p, size_t n) {
+		const unsigned char* c = (const unsigned char*) p;
+		for (size_t i = 0; i < n; i++) {
+			h ^= c[i];
+			h *= 1099511628211ULL;
+		}
+	};
+	mix(&m_n_cols, sizeof(int));
+	mix(&lfil, sizeof(int));
+	mix(&tol, sizeof(double));
+	mix(&pp_tol, sizeof(double));
+	mix(&piv_type, sizeof(int));
+	for (int j = 0; j < m_n_cols; j++) {
+		mix(m_idx[j].data(), m_idx[j].size()*sizeof(int));
+		mix(m_x[j].data(), m_x[j].size()*sizeof(el_type));
+	}
+	if (!mate.empty()) mix(mate.data(), mate.size()*sizeof(int));
+	return h;
+}
+
+template <class el_type>
+void lilc_matrix<el_type> :: write_state(std::ostream& out) const {
+	write_raw(out, m_n_rows);
+	write_raw(out, m_n_cols);
+	write_raw(out, nnz_count);
+	write_vecs(out, m_idx);
+	write_vecs(out, m_x);
+	write_vecs(out, list);
+	write_vec(out, row_first);
+	write_vec(out, col_first);
+}
+
+template <class el_type>
+void lilc_matrix<el_type> :: read_state(std::istream& in) {
+	read_raw(in, m_n_rows);
+	read_raw(in, m_n_cols);
+	read_raw(in, nnz_count);
+	read_vecs(in, m_idx);
+	read_vecs(in, m_x);
+	read_vecs(in, list);
+	read_vec(in, row_first);
+	read_vec(in, col_first);
+}
+
+template <class el_type>
+bool lilc_matrix<el_type> :: save_checkpoint(const lilc_matrix<el_type>& L, const block_diag_matrix<el_type>& D, const idx_vector_type& perm, const checkpoint_struct& st, unsigned long long key) const {
+	//the checkpoint is written next to the old one and then renamed over it, so
+	//that a job killed while writing still has the last complete checkpoint.
+	std::string tmp = checkpoint_file + ".tmp";
+	std::ofstream out(tmp.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!out) return false;
+
+	out.write(checkpoint_magic, sizeof(checkpoint_magic));
+	int el_size = sizeof(el_type);
+	write_raw(out, el_size);
+	write_raw(out, key);
+
+	write_raw(out, st.k);
+	write_raw(out, st.count);
+	write_raw(out, st.num_perturbed);
+	write_raw(out, st.num_pos_pivots);
+	write_raw(out, st.num_neg_pivots);
+	write_raw(out, st.num_zero_pivots);
+	write_raw(out, st.pivot_growth);
+	write_raw(out, st.bytes);
+	write_raw(out, st.peak_bytes);
+	write_vec(out, st.col_count);
+	write_vec(out, st.list_capacity);
+
+	write_vec(out, perm);
+	write_vec(out, S.main_diag);
+	write_state(out);
+	L.write_state(out);
+
+	write_vec(out, D.main_diag);
+	write_raw(out, D.nnz_count);
+	long long n_off = D.off_diag.size();
+	write_raw(out, n_off);
+	for (auto it = D.off_diag.begin(); it != D.off_diag.end(); it++) {
+		write_raw(out, it->first);
+		write_raw(out, it->second);
+	}
+
+	out.close();
+	if (!out) {
+		std::remove(tmp.c_str());
+		return false;
+	}
+	if (std::rename(tmp.c_str(), checkpoint_file.c_str()) != 0) {
+		//rename does not replace an existing file on every platform
+		std::remove(checkpoint_file.c_str());
+		if (std::rename(tmp.c_str(), checkpoint_file.c_str()) != 0) return false;
+	}
+	return true;
+}
+
+template <class el_type>
+bool lilc_matrix<el_type> :: load_checkpoint(lilc_matrix<el_type>& L, block_diag_matrix<el_type>& D, idx_vector_type& perm, checkpoint_struct& st, unsigned long long key) {
+	std::ifstream in(checkpoint_file.c_str(), std::ios::in | std::ios::binary);
+	if (!in) return false;
+
+	char magic[sizeof(checkpoint_magic)];
+	int el_size = 0;
+	unsigned long long file_key = 0;
+	in.read(magic, sizeof(magic));
+	read_raw(in, el_size);
+	read_raw(in, file_key);
+	if (!in || memcmp(magic, checkpoint_magic, sizeof(magic)) != 0 || el_size != (int) sizeof(el_type) || file_key != key) return false;
+
+	//everything is read into temporaries first, so that a damaged checkpoint
+	//leaves the factorization to start over from an untouched A.
+	checkpoint_struct cs;
+	read_raw(in, cs.k);
+	read_raw(in, cs.count);
+	read_raw(in, cs.num_perturbed);
+	read_raw(in, cs.num_pos_pivots);
+	read_raw(in, cs.num_neg_pivots);
+	read_raw(in, cs.num_zero_pivots);
+	read_raw(in, cs.pivot_growth);
+	read_raw(in, cs.bytes);
+	read_raw(in, cs.peak_bytes);
+	read_vec(in, cs.col_count);
+	read_vec(in, cs.list_capacity);
+
+	idx_vector_type perm_c;
+	elt_vector_type s_c;
+	lilc_matrix<el_type> A_c, L_c;
+	read_vec(in, perm_c);
+	read_vec(in, s_c);
+	A_c.read_state(in);
+	L_c.read_state(in);
+
+	elt_vector_type d_c;
+	read_vec(in, d_c);
+	int d_nnz = 0;
+	read_raw(in, d_nnz);
+	long long n_off = -1;
+	read_raw(in, n_off);
+	typename block_diag_matrix<el_type>::int_elt_map off_c;
+	for (long long t = 0; t < n_off && in; t++) {
+		int i; el_type x;
+		read_raw(in, i);
+		read_raw(in, x);
+		off_c[i] = x;
+	}
+
+	const int n = m_n_cols;
+	if (!in || n_off < 0 || cs.k < 0 || cs.k > n || (int) cs.col_count.size() != n || (int) cs.list_capacity.size() != n || (int) perm_c.size() != n || (int) s_c.size() != n
+		|| A_c.m_n_cols != n || L_c.m_n_cols != n || (int) L_c.m_idx.size() != n || (int) d_c.size() != n) return false;
+
+	st = cs;
+	perm.swap(perm_c);
+	S.main_diag.swap(s_c);
+	m_idx.swap(A_c.m_idx);
+	m_x.swap(A_c.m_x);
+	list.swap(A_c.list);
+	row_first.swap(A_c.row_first);
+	col_first.swap(A_c.col_first);
+	nnz_count = A_c.nnz_count;
+
+	//the columns of L still to be factored are empty, and keep what was reserved for them
+	for (int j = 0; j < st.k; j++) {
+		L.m_idx[j].swap(L_c.m_idx[j]);
+		L.m_x[j].swap(L_c.m_x[j]);
+	}
+	L.list.swap(L_c.list);
+	L.row_first.swap(L_c.row_first);
+	L.col_first.swap(L_c.col_first);
+	L.nnz_count = L_c.nnz_count;
+
+	D.main_diag.swap(d_c);
+	D.off_diag.swap(off_c);
+	D.nnz_count = d_nnz;
+	return true;
+}
+
+#endif
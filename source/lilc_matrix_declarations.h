@@ -7,9 +7,17 @@
 #include <cassert>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <set>
+#include <memory>
+#include <mutex>
 
 #include "swap_struct.h"
+#include "ildl_workspace.h"
+#include "bfs_struct.h"
+#include "ooc_struct.h"
+#include "checkpoint_struct.h"
+#include "mtx_text.h"
 
 /*! \brief A list-of-lists (LIL) matrix in column oriented format.
 
@@ -47,6 +55,26 @@ public:
     std::vector<int> col_first;	///<On iteration k, first[i] gives the number of non-zero elements on col i of A before A(i, k).
     
 	block_diag_matrix<el_type> S; ///<A diagonal scaling matrix S such that SAS will be equilibriated in the max-norm (i.e. every row/column has norm 1). S is constructed after running the sym_equil() function, after which SAS will be stored in place of A.
+
+	int num_perturbed; ///<The number of tiny pivots that were perturbed during the last call to ildl().
+	
+	double pivot_growth; ///<The largest entry of L (in magnitude) after the last call to ildl(). Large entries signal an unstable factorization, e.g. from many tiny pivots.
+	
+	size_t mem_budget; ///<If > 0, ildl() keeps the storage of L and D (and its own work vectors) within this many bytes, lowering lfil (and raising tol) for the remaining columns as the budget runs out, and dropping the smallest entries of a column that would not fit. The storage of A itself is not counted. Only a budget too small for the factors with no entries off the diagonal of L is exceeded (see peak_bytes).
+	size_t peak_bytes; ///<The largest storage of L and D (and the work vectors) during the last call to ildl(), in bytes.
+	
+	int max_neg_pivots; ///<If >= 0, ildl() stops as soon as D has more than this many negative eigenvalues, e.g. when the factorization of a KKT matrix is only useful with the right inertia. The factors are then incomplete and must not be used.
+	int num_neg_pivots; ///<The number of negative eigenvalues of D found by the last call to ildl() (only counted if max_neg_pivots >= 0).
+	
+	std::string ooc_file; ///<If not empty, ildl() keeps L out of core: the columns of L that the factorization is done with are evicted to this file (which is removed along with L), and streamed back in by the solves.
+	size_t ooc_window; ///<The number of bytes of finished columns of L that ildl() keeps in memory before evicting them (out-of-core factorizations only).
+	std::string checkpoint_file; ///<If not empty, ildl() periodically saves its state to this file, so that a factorization that is killed can be resumed (see resume_checkpoint). The file is removed once the factorization is done. Not used out of core.
+	double checkpoint_interval; ///<The number of seconds (of wall clock time) between two checkpoints of ildl().
+	bool resume_checkpoint; ///<If true, ildl() resumes from checkpoint_file if it holds a checkpoint of the same factorization (same matrix and parameters). Otherwise, the factorization starts over.
+	int resumed_at; ///<The column ildl() resumed from in its last call, or -1 if it started from the beginning.
+	std::shared_ptr< ooc_struct<el_type> > ooc; ///<The on-disk storage of the columns of this matrix, if it is an out-of-core factor (see ooc_file). Shared between copies.
+	
+	std::vector<int> mate; ///<The fixed 2x2 block structure used by static pivoting. mate[k] is the node paired with k into a 2x2 pivot (or -1 if k is a 1x1 pivot). Filled by sym_match() and permuted along with A by sym_perm(). If empty, ildl() pairs neighbouring columns instead.
     
     //-------------- types of pivoting procedures ----------------//
     /*! A simple enum class for listing the type of pivoting procedure SYM-ILDL uses.
@@ -54,7 +82,8 @@ public:
 	struct pivot_type {
 		enum {
 			BKP, 
-			ROOK
+			ROOK,
+			STATIC
 		};
 	};
 	
@@ -63,7 +92,7 @@ public:
 	/*! \brief Constructor for a column oriented list-of-lists (LIL) matrix. Space for both the values list and the indices list of the matrix is allocated here.
 	*/
 	lilc_matrix (int n_rows = 0, int n_cols = 0): 
-	lil_sparse_matrix<el_type> (n_rows, n_cols) 
+	lil_sparse_matrix<el_type> (n_rows, n_cols), num_perturbed(0), pivot_growth(0), mem_budget(0), peak_bytes(0), max_neg_pivots(-1), num_neg_pivots(0), ooc_window(0), checkpoint_interval(600), resume_checkpoint(true), resumed_at(-1)
 	{
 		m_x.reserve(n_cols);
 		m_idx.reserve(n_cols);
@@ -146,15 +175,17 @@ public:
 	/*!	\brief Returns a pseudo-peripheral root of A. This is essentially many chained breadth-first searchs across the graph of A (where A is viewed as an adjacency matrix).
 
 		\param s contains the initial node to seed the algorithm. A pseudo-peripheral root of A is stored in s at the end of the algorithm.
+		\param b the search workspace. Nodes visited by the searches done here are unmarked again before returning.
 	*/
-	void find_root(int& s);
+	void find_root(int& s, bfs_struct& b);
 	
 	/*!	\brief Returns the next level set given the current level set of A. This is essentially all neighbours of the currently enqueued nodes in breath-first search.
 		
-		\param lvl_set the current level set (a list of nodes).
-		\param visited all previously visited nodes.
+		The level is expanded top-down or bottom-up depending on the size of the frontier, in parallel if OpenMP is enabled.
+		\param b the search workspace. b.lvl_set holds the current level set on entry and the next level set on exit (if there is one).
+		\return True if the next level set is non-empty.
 	*/
-	inline bool find_level_set(vector<int>& lvl_set, vector<bool>& visited);
+	inline bool find_level_set(bfs_struct& b);
 	
 	/*!	\brief Returns a Reverse Cuthill-McKee ordering of the matrix A (stored in perm). 
 		
@@ -169,6 +200,14 @@ public:
 		\param perm An empty permutation vector (filled on function completion).
 	*/
 	inline void sym_amd(vector<int>& perm);
+	
+	/*! \brief Experimental: returns a Approximate Minimum Degree ordering of the matrix A (stored in perm), eliminating many pivots at once.
+		
+		Each round, a distance-2 independent set of nodes whose approximate degree is within a factor relax of the minimum degree is eliminated together, in parallel if OpenMP is enabled. Degree updates are relaxed (cheaper but looser bounds than sym_amd()), so the ordering is usually slightly worse than sym_amd(). The rounds do 8-10 times the work of sym_amd(), and no speedup over sym_amd() has been measured yet at any thread count. With one thread, sym_amd() is used instead.
+		\param perm An empty permutation vector (filled on function completion).
+		\param relax nodes with approximate degree up to relax*(minimum degree) are eliminated in the same round. relax = 1 only eliminates nodes of minimum degree.
+	*/
+	inline void sym_amd_par(vector<int>& perm, double relax = 1.1);
 		
 	/*! \brief Given a permutation vector perm, A is permuted to P'AP, where P is the permutation matrix associated with perm. 
 		\param perm the permutation vector.
@@ -180,6 +219,26 @@ public:
 		This algorithm is based on the one outlined in "Equilibration of Symmetric Matrices in the Max-Norm" by Bunch (1971).
 	*/
 	void sym_equil();
+
+	/*!	\brief Computes a fixed 2x2 block structure for static pivoting (stored in mate).
+		
+		Every node whose diagonal is too small to be a 1x1 pivot (by the Bunch-Kaufman test) is greedily paired with its largest unpaired neighbour, as long as the resulting 2x2 block is well conditioned. In KKT systems, this pairs the zero diagonal constraint rows with the variables they couple to.
+	*/
+	inline void sym_match();
+	
+	/*!	\brief Modifies the permutation perm so that the two nodes of every pair in mate are adjacent (the second is moved right after the first). Does nothing if mate is empty.
+		\param perm a permutation vector of A.
+	*/
+	inline void pair_perm(vector<int>& perm);
+	
+	/*!	\brief Computes the number of non-zeros in each column and row of the exact Cholesky factor of A, without computing the factor itself.
+		
+		The column counts are found with the algorithm of Gilbert, Ng, and Peyton (1994) in time nearly linear in nnz(A). They are used by ildl() to preallocate L.
+		\param col_count on exit, col_count[j] is the number of non-zeros in column j of the factor (including the diagonal).
+		\param row_count on exit, row_count[i] is the number of off-diagonal non-zeros in row i of the factor, capped at cap.
+		\param cap the largest row count that is computed exactly. Row counts cost O(n*cap) time.
+	*/
+	inline void sym_counts(idx_vector_type& col_count, idx_vector_type& row_count, int cap);
 	
 	//----Factorizations----//
 	/*! \brief Performs an LDL' factorization of this matrix. 
@@ -192,9 +251,10 @@ public:
 		\param fill_factor a parameter to control memory usage. Each column is guaranteed to have fewer than fill_factor*(nnz(A)/n_col(A)) elements.
 		\param tol a parameter to control agressiveness of dropping. In each column, elements less than tol*norm(column) are dropped.
 	    \param pp_tol a parameter to control aggresiveness of pivoting. Allowable ranges are [0,inf). If the parameter is >= 1, Bunch-Kaufman pivoting will be done in full. If the parameter is 0, partial pivoting will be turned off and the first non-zero pivot under the diagonal will be used. Choices close to 0 increase locality in pivoting (pivots closer to the diagonal are used) while choices closer to 1 increase the stability of pivoting. Useful for situations where you care more about preserving the structure of the matrix rather than bounding the size of its elements.
-        \param pivot_type chooses the type of pivoting procedure used: threshold Bunch-Kaufman, or rook pivoting. If rook pivoting is chosen, pp_tol is ignored.
+        \param pivot_type chooses the type of pivoting procedure used: threshold Bunch-Kaufman, rook, or static pivoting. If rook pivoting is chosen, pp_tol is ignored. Static pivoting never swaps rows or columns: column k is either a 1x1 pivot or forms a 2x2 pivot with column k+1, and pivots smaller than sqrt(machine eps)*||A|| are perturbed to that size. The factorization then follows the symbolic structure of A, at the cost of needing iterative refinement in the solve. The number of perturbed pivots is stored in num_perturbed.
+		\param ws an optional workspace for the temporary vectors, which is reused across calls (see ildl_workspace).
 	*/
-	void ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type = pivot_type::BKP);
+	void ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type = pivot_type::BKP, ildl_workspace<el_type>* ws = NULL);
 	
     /*! \brief Performs an _inplace_ LDL' factorization of this matrix. 
 		
@@ -205,23 +265,76 @@ public:
 		\param fill_factor a parameter to control memory usage. Each column is guaranteed to have fewer than fill_factor*(nnz(A)/n_col(A)) elements.
 		\param tol a parameter to control agressiveness of dropping. In each column, elements less than tol*norm(column) are dropped.
 	    \param pp_tol a parameter to control aggresiveness of pivoting. Allowable ranges are [0,inf). If the parameter is >= 1, Bunch-Kaufman pivoting will be done in full. If the parameter is 0, partial pivoting will be turned off and the first non-zero pivot under the diagonal will be used. Choices close to 0 increase locality in pivoting (pivots closer to the diagonal are used) while choices closer to 1 increase the stability of pivoting. Useful for situations where you care more about preserving the structure of the matrix rather than bounding the size of its elements.
+		\param ws an optional workspace for the temporary vectors, which is reused across calls (see ildl_workspace).
 	*/
-	void ildl_inplace(block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type = pivot_type::BKP);
+	void ildl_inplace(block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type = pivot_type::BKP, ildl_workspace<el_type>* ws = NULL);
     
 	//------Helpers------//
+	/*! \brief Gives the indices and values of column j, whether it is in memory or has been evicted to disk (see ooc_file). For an out-of-core matrix, the caller must hold ooc_lock().
+		
+		\param j the column.
+		\param idx set to the indices of the column.
+		\param x set to the values of the column.
+		\param len set to the length of the column.
+		\param backwards set to true if the columns are being visited from last to first, so that reads from disk are done ahead in that direction.
+	*/
+	inline void column(int j, const int*& idx, const el_type*& x, int& len, bool backwards = false) const {
+		if (ooc && ooc->state[j] == 2) {
+			len = ooc->len[j];
+			ooc->fetch(j, idx, x, backwards);
+		} else {
+			len = m_idx[j].size();
+			idx = m_idx[j].data();
+			x = m_x[j].data();
+		}
+	}
+	
+	/*! \return A lock on the on-disk storage of an out-of-core matrix, which serializes the solves (they share its read buffer). For a matrix in memory, nothing is locked.
+	*/
+	std::unique_lock<std::mutex> ooc_lock() const {
+		if (ooc) return std::unique_lock<std::mutex>(ooc->lock);
+		return std::unique_lock<std::mutex>();
+	}
+	
 	/*! \brief Performs a back solve of this matrix, assuming that it is lower triangular (stored column major). 
 		
 		\param b the right hand side.
 		\param x a storage vector for the solution (must be same size as b).
 	*/
-	void backsolve(const elt_vector_type& b, elt_vector_type& x) {
+	void backsolve(const elt_vector_type& b, elt_vector_type& x) const {
 		assert(b.size() == x.size());
 		x = b;
 		// simple forward substitution
+		std::unique_lock<std::mutex> guard = ooc_lock();
+		const int* idx; const el_type* lx; int len;
+		for (int i = 0; i < m_n_cols; i++) {
+			column(i, idx, lx, len);
+			x[i] /= lx[0];
+			for (int k = 1; k < len; k++) {
+				x[idx[k]] -= x[i]*lx[k];
+			}
+		}
+	}
+	
+	/*! \brief Performs a back solve of this matrix on the gathered and scaled right hand side b2[i] = scale[perm[i]]*b[perm[i]], without forming b2.
+		
+		\param b the right hand side.
+		\param x a storage vector for the solution (must be same size as b).
+		\param perm the permutation gathered by.
+		\param scale the scaling applied to b (before permuting).
+	*/
+	void backsolve(const elt_vector_type& b, elt_vector_type& x, const idx_vector_type& perm, const elt_vector_type& scale) const {
+		assert(b.size() == x.size());
 		for (int i = 0; i < m_n_cols; i++) {
-			x[i] /= m_x[i][0];
-			for (int k = 1; k < m_idx[i].size(); k++) {
-				x[m_idx[i][k]] -= x[i]*m_x[i][k];
+			x[i] = scale[perm[i]]*b[perm[i]];
+		}
+		std::unique_lock<std::mutex> guard = ooc_lock();
+		const int* idx; const el_type* lx; int len;
+		for (int i = 0; i < m_n_cols; i++) {
+			column(i, idx, lx, len);
+			x[i] /= lx[0];
+			for (int k = 1; k < len; k++) {
+				x[idx[k]] -= x[i]*lx[k];
 			}
 		}
 	}
@@ -231,13 +344,126 @@ public:
 		\param b the right hand side.
 		\param x a storage vector for the solution (must be same size as b).
 	*/
-	void forwardsolve(const elt_vector_type& b, elt_vector_type& x) {
+	void forwardsolve(const elt_vector_type& b, elt_vector_type& x) const {
 		assert(b.size() == x.size());
 		// simple back substitution
+		std::unique_lock<std::mutex> guard = ooc_lock();
+		const int* idx; const el_type* lx; int len;
+		for (int i = m_n_cols-1; i >= 0; i--) {
+			column(i, idx, lx, len, true);
+			x[i] = b[i]/lx[0];
+			for (int k = 1; k < len; k++) {
+				x[i] -= x[idx[k]]*lx[k]/lx[0];
+			}
+		}
+	}
+	
+	/*! \brief Performs a forward solve of this matrix, and scatters and scales the solution into out[perm[i]] = scale[perm[i]]*x[i] in the same sweep.
+		
+		\param b the right hand side.
+		\param x a storage vector for the solution (must be same size as b, and may be b itself).
+		\param out a storage vector for the scattered and scaled solution.
+		\param perm the permutation scattered by.
+		\param scale the scaling applied to the solution (after permuting).
+	*/
+	void forwardsolve(const elt_vector_type& b, elt_vector_type& x, elt_vector_type& out, const idx_vector_type& perm, const elt_vector_type& scale) const {
+		assert(b.size() == x.size() && out.size() == x.size());
+		std::unique_lock<std::mutex> guard = ooc_lock();
+		const int* idx; const el_type* lx; int len;
 		for (int i = m_n_cols-1; i >= 0; i--) {
-			x[i] = b[i]/m_x[i][0];
-			for (int k = 1; k < m_idx[i].size(); k++) {
-				x[i] -= x[m_idx[i][k]]*m_x[i][k]/m_x[i][0];
+			column(i, idx, lx, len, true);
+			x[i] = b[i]/lx[0];
+			for (int k = 1; k < len; k++) {
+				x[i] -= x[idx[k]]*lx[k]/lx[0];
+			}
+			out[perm[i]] = scale[perm[i]]*x[i];
+		}
+	}
+	
+	/*! \brief Finds the nonzero pattern of the solution of a triangular solve with this matrix (the set of nodes reachable from the nonzeros of b in the graph of the matrix), by depth first search.
+		
+		\param b_idx the nonzero indices of the right hand side.
+		\param transposed if true, the graph of the transpose is searched (using list), for solves with L' instead of L.
+		\param xi a storage vector for the pattern of the solution, in the order the solve must visit it.
+		\param marked a bitset of size n_cols(), which must be all false (it is left all false).
+		\param stack a storage vector for the search stack.
+	*/
+	void reach(const idx_vector_type& b_idx, bool transposed, idx_vector_type& xi, vector<bool>& marked, idx_vector_type& stack) const;
+	
+	/*! \brief Performs a back solve of this matrix (as in backsolve()) for a sparse right hand side, touching only the columns that the solution depends on. The cost is proportional to the flops done, instead of O(n + nnz).
+		
+		\param b_idx the nonzero indices of the right hand side.
+		\param x on entry, the right hand side (zero outside of b_idx). On exit, the solution (zero outside of xi).
+		\param xi a storage vector for the nonzero pattern of the solution.
+		\param marked a bitset of size n_cols(), which must be all false (it is left all false).
+		\param stack a storage vector for the search stack.
+	*/
+	void sparse_backsolve(const idx_vector_type& b_idx, elt_vector_type& x, idx_vector_type& xi, vector<bool>& marked, idx_vector_type& stack) const;
+	
+	/*! \brief Performs a forward solve of this matrix (as in forwardsolve()) for a sparse right hand side, touching only the rows that the solution depends on. Requires the row lists (list) of the matrix, which ildl() fills in for L.
+		
+		\param b_idx the nonzero indices of the right hand side.
+		\param x on entry, the right hand side (zero outside of b_idx). On exit, the solution (zero outside of xi).
+		\param xi a storage vector for the nonzero pattern of the solution.
+		\param marked a bitset of size n_cols(), which must be all false (it is left all false).
+		\param stack a storage vector for the search stack.
+	*/
+	void sparse_forwardsolve(const idx_vector_type& b_idx, elt_vector_type& x, idx_vector_type& xi, vector<bool>& marked, idx_vector_type& stack) const;
+	
+	/*! \brief Computes selected entries of the inverse of LDL' (where this matrix is L) with the Takahashi equations, without forming any other entries of the inverse.
+		
+		The entries computed are those on the filled pattern of L (the pattern of L closed under symbolic elimination), which contains the diagonal and the pattern of L. When L is an exact factor, this is the pattern of L itself. The cost is comparable to that of factoring a matrix with this pattern.
+		
+		\param D the D factor of the matrix, whose 1x1 and 2x2 blocks define the block columns of L.
+		\param Z a storage matrix for the lower triangle of the selected entries of (LDL')^(-1). Each column stores its diagonal first.
+	*/
+	void selected_inverse(const block_diag_matrix<el_type>& D, lilc_matrix<el_type>& Z) const;
+	
+	/*! \return A hash of this matrix and the parameters of ildl(), which identifies the factorization a checkpoint belongs to.
+	*/
+	unsigned long long fingerprint(int lfil, double tol, double pp_tol, int piv_type) const;
+	
+	/*! \brief Writes the sizes, columns, row lists and first arrays of this matrix to a binary stream.
+	*/
+	void write_state(std::ostream& out) const;
+	
+	/*! \brief Reads the state written by write_state() back from a binary stream. On a failed read, the stream is left in a failed state.
+	*/
+	void read_state(std::istream& in);
+	
+	/*! \brief Saves a checkpoint of ildl() (this matrix, L, D, perm, and the loop state) to checkpoint_file.
+		\param L the partial lower triangular factor.
+		\param D the partial diagonal factor.
+		\param perm the current permutation.
+		\param st the loop state of ildl().
+		\param key the fingerprint() of the factorization.
+		\return True if the checkpoint was written.
+	*/
+	bool save_checkpoint(const lilc_matrix<el_type>& L, const block_diag_matrix<el_type>& D, const idx_vector_type& perm, const checkpoint_struct& st, unsigned long long key) const;
+	
+	/*! \brief Restores this matrix, L, D, perm, and the loop state of ildl() from the checkpoint in checkpoint_file. Nothing is changed unless the whole checkpoint could be read and belongs to the same factorization.
+		\param L the lower triangular factor, with its columns allocated.
+		\param D the diagonal factor.
+		\param perm the permutation.
+		\param st the loop state of ildl().
+		\param key the fingerprint() of the factorization.
+		\return True if the checkpoint was restored.
+	*/
+	bool load_checkpoint(lilc_matrix<el_type>& L, block_diag_matrix<el_type>& D, idx_vector_type& perm, checkpoint_struct& st, unsigned long long key);
+	
+	/*! \brief Adds alpha to the diagonal of this matrix (A = A + alpha*I), creating any diagonal elements that are not stored. New diagonal elements are moved to the front of their columns, as ildl() expects.
+		\param alpha the shift.
+	*/
+	void shift_diagonal(el_type alpha) {
+		for (int j = 0; j < m_n_cols; j++) {
+			int k = std::find(m_idx[j].begin(), m_idx[j].end(), j) - m_idx[j].begin();
+			if (k == (int) m_idx[j].size()) {
+				m_idx[j].push_back(j);
+				m_x[j].push_back(alpha);
+				nnz_count++;
+				ensure_invariant(j, j, m_idx[j]);
+			} else {
+				m_x[j][k] += alpha;
 			}
 		}
 	}
@@ -248,7 +474,7 @@ public:
 		\param y a storage vector for the result (must be same size as x).
 		\param full_mult if true, we assume that only half the matrix is stored and do do operations per element of the matrix to account for the unstored other half.
 	*/
-	void multiply(const elt_vector_type& x, elt_vector_type& y, bool full_mult = true) {
+	void multiply(const elt_vector_type& x, elt_vector_type& y, bool full_mult = true) const {
 		y.clear(); y.resize(x.size(), 0);
 		for (int i = 0; i < m_n_cols; i++) {
 			for (int k = 0; k < m_idx[i].size(); k++) {
@@ -385,12 +611,18 @@ public:
 #include "lilc_matrix_find_root.h"
 #include "lilc_matrix_sym_rcm.h"
 #include "lilc_matrix_sym_amd.h"
+#include "lilc_matrix_sym_amd_par.h"
 #include "lilc_matrix_sym_perm.h"
 #include "lilc_matrix_sym_equil.h"
+#include "lilc_matrix_sym_counts.h"
+#include "lilc_matrix_sym_match.h"
 #include "lilc_matrix_ildl_helpers.h"
 #include "lilc_matrix_ildl.h"
 #include "lilc_matrix_ildl_inplace.h"
 #include "lilc_matrix_pivot.h"
+#include "lilc_matrix_sparse_solve.h"
+#include "lilc_matrix_selected_inverse.h"
+#include "lilc_matrix_checkpoint.h"
 #include "lilc_matrix_load.h"
 #include "lilc_matrix_save.h"
 #include "lilc_matrix_to_string.h"
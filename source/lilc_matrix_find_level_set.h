@@ -3,28 +3,94 @@
 #define _LILC_MATRIX_FIND_LEVEL_SET_H_
 
 template<class el_type>
-inline bool lilc_matrix<el_type> :: find_level_set(vector<int>& lvl_set, vector<bool>& visited) {
-	vector<int> new_set;
-	for (idx_it node_it = lvl_set.begin(); node_it != lvl_set.end(); node_it++) {
-
-		for (idx_it it = list[*node_it].begin(); it != list[*node_it].end(); it++) {
-			if (!visited[*it]) {
-				visited[*it] = true;
-				new_set.push_back(*it);
+inline bool lilc_matrix<el_type> :: find_level_set(bfs_struct& b) {
+	// switching thresholds from Beamer et al. (2012): go bottom-up once the frontier
+	// touches more than 1/alpha of the unvisited edges, and back to top-down once
+	// the frontier holds fewer than 1/beta of the nodes.
+	const int alpha = 14, beta = 24, par_min = 256;
+	const int n = m_n_cols, nthreads = (int) b.local.size();
+	const int lsize = (int) b.lvl_set.size();
+	int i;
+
+	long long frontier_edges = 0;
+	#pragma omp parallel for reduction(+:frontier_edges) if(lsize > par_min)
+	for (i = 0; i < lsize; i++) {
+		frontier_edges += b.deg[b.lvl_set[i]];
+	}
+
+	if (!b.bottom_up && frontier_edges > b.unvisited_edges/alpha) {
+		b.bottom_up = true;
+	} else if (b.bottom_up && (long long) lsize*beta < n) {
+		b.bottom_up = false;
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		b.local[i].clear();
+	}
+
+	if (!b.bottom_up) {
+		//top-down: visit every unvisited neighbour of the frontier
+		#pragma omp parallel for schedule(dynamic, 64) if(lsize > par_min)
+		for (i = 0; i < lsize; i++) {
+			vector<int>& next = b.local[bfs_struct::thread_id()];
+			const int node = b.lvl_set[i];
+
+			for (idx_it it = list[node].begin(); it != list[node].end(); it++) {
+				if (b.claim(*it)) next.push_back(*it);
+			}
+
+			for (idx_it it = m_idx[node].begin(); it != m_idx[node].end(); it++) {
+				if (b.claim(*it)) next.push_back(*it);
 			}
 		}
+	} else {
+		//bottom-up: every unvisited node looks for a parent in the frontier
+		for (i = 0; i < lsize; i++) {
+			bfs_struct::set(b.frontier, b.lvl_set[i]);
+		}
 		
-		for (idx_it it = m_idx[*node_it].begin(); it != m_idx[*node_it].end(); it++) {
-			if (!visited[*it]) {
-				visited[*it] = true;
-				new_set.push_back(*it);
+		#pragma omp parallel for schedule(dynamic, 1024)
+		for (i = 0; i < n; i++) {
+			if (bfs_struct::test(b.visited, i)) continue;
+			vector<int>& next = b.local[bfs_struct::thread_id()];
+
+			bool found = false;
+			for (idx_it it = list[i].begin(); it != list[i].end() && !found; it++) {
+				found = bfs_struct::test(b.frontier, *it);
+			}
+
+			for (idx_it it = m_idx[i].begin(); it != m_idx[i].end() && !found; it++) {
+				found = bfs_struct::test(b.frontier, *it);
+			}
+
+			if (found) next.push_back(i);
+		}
+
+		for (i = 0; i < lsize; i++) {
+			bfs_struct::reset(b.frontier, b.lvl_set[i]);
+		}
+
+		//only now is it safe to mark the new level as visited
+		for (i = 0; i < nthreads; i++) {
+			for (idx_it it = b.local[i].begin(); it != b.local[i].end(); it++) {
+				bfs_struct::set(b.visited, *it);
 			}
 		}
 	}
 	
-	if (new_set.empty()) return false;
+	b.new_set.clear();
+	for (i = 0; i < nthreads; i++) {
+		b.new_set.insert(b.new_set.end(), b.local[i].begin(), b.local[i].end());
+	}
 	
-	lvl_set.swap(new_set);
+	if (b.new_set.empty()) return false;
+
+	for (idx_it it = b.new_set.begin(); it != b.new_set.end(); it++) {
+		b.unvisited_edges -= b.deg[*it];
+	}
+	b.reached.insert(b.reached.end(), b.new_set.begin(), b.new_set.end());
+
+	b.lvl_set.swap(b.new_set);
 	return true;
 }
 
@@ -1,13 +1,14 @@
 #ifndef _LILC_MATRIX_ILDL_H_
 #define _LILC_MATRIX_ILDL_H_
 
+#include <chrono>
 
 using std::endl;
 using std::cout;
 using std::abs;
 
 template <class el_type>
-void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type)
+void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type, ildl_workspace<el_type>* ws)
 {
 
 	//----------------- initialize temporary variables --------------------//
@@ -22,23 +23,175 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 	el_type det_D, D_inv11, D_inv22, D_inv12;	//for use in 2x2 pivots
 	el_type l_11, l_12;							//for use in 2x2 pivots
 
-	vector<bool> in_set(ncols, false); //bitset used for unsorted merges
-	swap_struct<el_type> s;	//struct containing temp vars used in pivoting.
+	//the work vectors are taken from ws if given (see ildl_workspace), and are
+	//otherwise allocated for this call only.
+	ildl_workspace<el_type> own_ws;
+	ildl_workspace<el_type>& w = (ws ? *ws : own_ws);
+	w.resize(ncols);
 	
-	elt_vector_type work(ncols, 0), temp(ncols, 0); ////work vector for the current column
-	idx_vector_type curr_nnzs, temp_nnzs;  //non-zeros on current col.
-	curr_nnzs.reserve(ncols); //reserves space for worse case (entire col is non-zero)
+	vector<bool>& in_set = w.in_set; //bitset used for unsorted merges
+	swap_struct<el_type>& s = w.s;	//struct containing temp vars used in pivoting.
+	
+	elt_vector_type& work = w.work, & temp = w.temp; //work vector for the current column
+	idx_vector_type& curr_nnzs = w.curr_nnzs, & temp_nnzs = w.temp_nnzs;  //non-zeros on current col.
 
-	int count = 0; //the total number of nonzeros stored in L.
 	int i, j, k, r, offset, col_size, col_size2(-1);
+
+	//static pivoting never swaps rows, so tiny pivots are perturbed instead (to
+	//sqrt(eps)*||A|| in the max norm, or sqrt(eps)*||A||^2 for the determinant of a
+	//2x2 pivot, which scales with ||A||^2). other pivoting schemes set any pivot or
+	//determinant below eps to 1e-6.
+	const bool static_piv = (piv_type == pivot_type::STATIC);
+	el_type max_A = 0;
+	if (static_piv) {
+		for (k = 0; k < ncols; k++) {
+			for (elt_it it = m_x[k].begin(); it != m_x[k].end(); it++) {
+				max_A = std::max(max_A, (el_type) abs(*it));
+			}
+		}
+	}
+	const el_type piv_tol = (static_piv ? sqrt(std::numeric_limits<el_type>::epsilon())*max_A : eps);
+	const el_type piv_pert = (static_piv ? piv_tol : 1e-6);
+	const el_type det_tol = (static_piv ? piv_tol*max_A : eps);
+	const el_type det_pert = (static_piv ? det_tol : 1e-6);
+	num_perturbed = 0;
+	num_neg_pivots = 0;
+	pivot_growth = 0;
+	int num_pos_pivots = 0, num_zero_pivots = 0;
+
+	int count = 0; //the total number of nonzeros stored in L.
 	bool size_two_piv = false;	//boolean indicating if the pivot is 2x2 or 1x1
 
 	//--------------- allocate memory for L and D ------------------//
 	L.resize(ncols, ncols); //allocate a vector of size n for Llist as well
 	D.resize(ncols );
 	
+	//out-of-core: the old store (if any) is dropped first, since it removes its file.
+	//if the file cannot be created, L is simply kept in memory.
+	L.ooc.reset();
+	if (!ooc_file.empty()) {
+		L.ooc = std::make_shared< ooc_struct<el_type> >(ooc_file, ncols, ooc_window);
+		if (!L.ooc->file.is_open()) L.ooc.reset();
+	}
+	const bool out_of_core = (bool) L.ooc;
+	
+	//checkpoints are matched to the factorization by a hash of A (before any of it
+	//is pivoted) and of the parameters.
+	const bool checkpointing = !checkpoint_file.empty() && !out_of_core;
+	const unsigned long long key = (checkpointing ? fingerprint(lfil, tol, pp_tol, piv_type) : 0);
+
+	//symbolic phase: bound the size of each column of L by min(lfil, column count of
+	//the exact factor) and reserve it up front, so the numeric loop below does not
+	//reallocate. pivoting can still move entries around, in which case the affected
+	//columns just grow as before.
+	idx_vector_type& col_count = w.col_count, & row_count = w.row_count;
+	sym_counts(col_count, row_count, lfil);
+	
+	//the storage of the factors is tracked as they are formed (see peak_bytes), by the
+	//capacity of every vector of L. the fixed part is the column headers of L, D, and
+	//the work vectors of this function. every entry of L costs an index and a value in
+	//L, and an index in L.list.
+	const size_t entry_bytes = 2*sizeof(int) + sizeof(el_type);
+	const size_t d_bytes = sizeof(std::pair<const int, el_type>) + 2*sizeof(void*); //an off-diagonal of D
+	size_t bytes = (size_t) ncols*(3*sizeof(idx_vector_type) + 2*sizeof(int) + 3*sizeof(el_type) + 4*sizeof(int)) + ncols/8;
+	
+	//with a memory budget, the off-diagonals of D that 2x2 pivots in columns after col
+	//may need are set aside, so that L never takes the room they need. the columns
+	//reserved up front must fit in what the budget leaves after this and the fixed part.
+	const bool budget = (mem_budget > 0);
+	auto limit = [&](int col) { return (double) mem_budget - (double) ((ncols - col - 1)/2)*d_bytes; };
+	int max_col = ncols;
+	if (budget) {
+		double room = (limit(-1) - bytes)/((double) ncols*entry_bytes);
+		max_col = (int) std::max(0.0, std::min((double) ncols, room - 1));
+	}
+	
+	//out of core, nothing is reserved, since that would allocate all of L up front.
+	size_t list_reserved = 0;
+	for (k = 0; k < ncols && !out_of_core; k++) {
+		col_size = std::min(std::min(lfil, max_col), col_count[k] - 1) + 1;
+		L.m_idx[k].reserve(col_size);
+		L.m_x[k].reserve(col_size);
+		L.list[k].reserve(std::min(row_count[k], max_col));
+		
+		col_count[k] = L.m_idx[k].capacity(); //from here on, the storage reserved for column k
+		bytes += col_count[k]*(sizeof(int) + sizeof(el_type));
+		list_reserved += L.list[k].capacity();
+	}
+	if (out_of_core) col_count.assign(ncols, 0);
+	bytes += list_reserved*sizeof(int);
+	auto used = [&]() { return bytes - (out_of_core ? L.ooc->freed : 0); };
+	int lfil_k = lfil;
+	double tol_k = tol, share = 0;
+	
+	//a full row list grows by half (push_back may double it), and the growth is
+	//charged as it happens.
+	auto list_growth = [&](int i, size_t extra) -> size_t {
+		const size_t len = L.list[i].size() + extra;
+		return (len < L.list[i].capacity() ? 0 : len/2 + 1);
+	};
+	auto list_push = [&](int i, int col) {
+		const size_t g = list_growth(i, 0);
+		if (g) {
+			L.list[i].reserve(L.list[i].size() + g);
+			bytes += g*sizeof(int);
+		}
+		L.list[i].push_back(col);
+	};
+	
+	//the storage that keeping the entries nnzs in column col of L would add: the
+	//growth of the column past its capacity, and that of the row lists of the entries.
+	//extra is the number of entries already headed for each of these lists.
+	auto col_cost = [&](int col, const idx_vector_type& nnzs, size_t extra) {
+		size_t b = 0;
+		const size_t len = nnzs.size() + 1, cap = L.m_idx[col].capacity();
+		if (len > cap) b += (len - cap)*(sizeof(int) + sizeof(el_type));
+		for (int i : nnzs) b += list_growth(i, extra)*sizeof(int);
+		return b;
+	};
+	
+	//resume from the last checkpoint, which puts back A, L, D and perm as they were
+	//at the start of column st.k, along with the counters of this loop.
+	checkpoint_struct st;
+	int k_start = 0;
+	resumed_at = -1;
+	if (checkpointing && resume_checkpoint && load_checkpoint(L, D, perm, st, key)) {
+		k_start = resumed_at = st.k;
+		count = st.count;
+		num_perturbed = st.num_perturbed;
+		num_pos_pivots = st.num_pos_pivots;
+		num_neg_pivots = st.num_neg_pivots;
+		num_zero_pivots = st.num_zero_pivots;
+		pivot_growth = st.pivot_growth;
+		bytes = st.bytes;
+		peak_bytes = st.peak_bytes;
+		col_count.swap(st.col_count);
+		
+		//the checkpoint keeps the entries of L but not the storage reserved for them,
+		//which is put back as it was, since the memory budget depends on it.
+		for (j = 0; j < ncols; j++) {
+			L.list[j].reserve(st.list_capacity[j]);
+			if (j < k_start) continue;
+			L.m_idx[j].reserve(col_count[j]);
+			L.m_x[j].reserve(col_count[j]);
+		}
+	}
+	if (k_start == 0) peak_bytes = used();
+	auto next_checkpoint = std::chrono::steady_clock::now() + std::chrono::duration<double>(checkpoint_interval);
+	
 	//------------------- main loop: factoring begins -------------------------//
-	for (k = 0; k < ncols; k++) {
+	for (k = k_start; k < ncols; k++) {
+		//to stay within the memory budget, the space left after the columns done so far
+		//is shared evenly among the remaining columns (on top of what was reserved for
+		//them). when this makes lfil smaller, tol is raised in proportion, so that the
+		//entries kept are always the largest ones. the second column of a 2x2 pivot gets
+		//a share of its own (see lfil_k1), and columns that still do not fit in what is
+		//left are cut down further once they are formed.
+		if (budget) {
+			share = (limit(k) - (double) used())/(ncols - k);
+			lfil_k = std::min(lfil, (int) std::max(0.0, col_count[k] - 1 + share/entry_bytes));
+			tol_k = (lfil_k < lfil ? std::max(tol, 1e-8)*lfil/std::max(lfil_k, 1) : tol);
+		}
 		
 		//curr nnz vector starts out empty and is cleared at the end of each loop iteration.
 		//assign nonzeros indices of A(k:n, k) to curr_nnzs
@@ -295,6 +448,48 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
                 }
             }
             //--------------end rook pivoting--------------//
+        } else if (piv_type == pivot_type::STATIC) {
+            //--------------begin static pivoting--------------//
+            //no rows or columns are swapped. column k is paired with column k+1 into a
+            //2x2 pivot if the block structure in mate says so (or, without one, if d1 is
+            //too small relative to the rest of the column), provided that the 2x2 block
+            //is well conditioned and its off-diagonal is not negligible next to ||A||.
+            //otherwise a tiny d1 is perturbed below.
+            work[k] = d1;
+            r = k+1;
+            
+            bool pair = (mate.empty() ? alpha * w1 > abs(d1) : mate[k] == r);
+            if (r < ncols && pair && abs(work[r]) > eps*max_A) {
+                offset = row_first[r];
+                //assign all nonzero indices and values in A(r, k:r) 
+                //( not including A(r,r) ) to temp and temp_nnzs
+                for (j = offset; j < (int) list[r].size(); j++) {
+                    temp_nnzs.push_back(list[r][j]);
+                    temp[list[r][j]] = coeff(r, list[r][j]);
+                }
+
+                //assign nonzero indices and values of A(r:n, r) to temp_nnzs and temp
+                temp_nnzs.insert(temp_nnzs.end(), m_idx[r].begin(), m_idx[r].end());
+                for (j = 0; j < (int) m_idx[r].size(); j++) {
+                    temp[m_idx[r][j]] = m_x[r][j];
+                }
+
+                //perform delayed updates on temp. temp = Sum_{i=0}^{k-1} L(r,i) * D(i,i) * L(k:n, i).
+                update(r, temp, temp_nnzs, L, D, in_set);
+                dr = temp[r];
+                
+                if (abs(d1*dr - work[r]*work[r]) > alpha * work[r]*work[r]) {
+                    size_two_piv = true;
+                    advance_list(k);
+                    L.advance_first(k);
+                } else {
+                    for (idx_it it = temp_nnzs.begin(); it != temp_nnzs.end(); it++) {
+                        temp[*it] = 0;
+                    }
+                    temp_nnzs.clear();
+                }
+            }
+            //--------------end static pivoting--------------//
         }
 
 		//erase diagonal element from non-zero indices (to exclude it from being dropped)
@@ -303,7 +498,16 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 		//performs the dual dropping procedure.
 		if (!size_two_piv) {
 			//perform dual dropping criteria on work
-			drop_tol(work, curr_nnzs, lfil, tol);
+			drop_tol(work, curr_nnzs, lfil_k, tol_k);
+			
+			//the smallest entries left are dropped until the column fits in the budget
+			if (budget) {
+				size_t b;
+				while (!curr_nnzs.empty() && used() + (b = col_cost(k, curr_nnzs, 0)) > limit(k)) {
+					const int over = (used() + b - limit(k))/entry_bytes;
+					drop_tol(work, curr_nnzs, std::max(0, (int) curr_nnzs.size() - 1 - over), tol_k);
+				}
+			}
 
 		} else {
 			//erase diagonal 2x2 block from non-zero indices (to exclude it from being dropped)
@@ -313,7 +517,10 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 			
 			//compute inverse of the 2x2 block diagonal pivot.
 			det_D = d1*dr - work[k+1]*work[k+1];
-			if ( abs(det_D) < eps) det_D = 1e-6;  //statically pivot;
+			if ( abs(det_D) < det_tol) { //statically pivot
+				det_D = (static_piv && det_D < 0 ? -det_pert : det_pert);
+				num_perturbed++;
+			}
 			D_inv11 = dr/det_D;
 			D_inv22 = d1/det_D;
 			D_inv12 = -work[k+1]/det_D;
@@ -341,13 +548,29 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 			temp_nnzs.assign(curr_nnzs.begin(), curr_nnzs.end());
 			
 			//perform dual dropping procedure on work and temp
-			drop_tol(temp, temp_nnzs, lfil, tol);
-			drop_tol(work, curr_nnzs, lfil, tol);
+			const int lfil_k1 = (budget ? std::min(lfil, (int) std::max(0.0, col_count[k+1] - 1 + share/entry_bytes)) : lfil_k);
+			drop_tol(temp, temp_nnzs, lfil_k1, tol_k);
+			drop_tol(work, curr_nnzs, lfil_k, tol_k);
+			
+			//the smallest entries left are dropped until both columns (and the
+			//off-diagonal of D) fit in the budget
+			if (budget) {
+				size_t b;
+				while (!(curr_nnzs.empty() && temp_nnzs.empty()) && used() + (b = col_cost(k, curr_nnzs, 0) + col_cost(k+1, temp_nnzs, 1) + d_bytes) > limit(k+1)) {
+					const int over = (used() + b - limit(k+1))/entry_bytes;
+					const int keep = std::max(0, (int) std::max(curr_nnzs.size(), temp_nnzs.size()) - 1 - over/2);
+					drop_tol(temp, temp_nnzs, keep, tol_k);
+					drop_tol(work, curr_nnzs, keep, tol_k);
+				}
+			}
 			
 
 		}
 
-		//resize kth column of L to proper size.
+		//resize kth column of L to proper size. a column that outgrows what was reserved
+		//for it grows to just this size, which is what the budget was charged for.
+		L.m_idx[k].reserve(curr_nnzs.size()+1);
+		L.m_x[k].reserve(curr_nnzs.size()+1);
 		L.m_idx[k].resize(curr_nnzs.size()+1);
 		L.m_x[k].resize(curr_nnzs.size()+1);
 		
@@ -360,14 +583,17 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 		count++;
 		
 		if (!size_two_piv) {
-			if ( abs(D[k]) < eps) D[k] = 1e-6; //statically pivot
+			if ( abs(D[k]) < piv_tol) { //statically pivot
+				D[k] = (static_piv && D[k] < 0 ? -piv_pert : piv_pert);
+				num_perturbed++;
+			}
 			i = 1;
 			for (idx_it it = curr_nnzs.begin(); it != curr_nnzs.end(); it++) { 
 				if ( abs(work[*it]) > eps) {
 					L.m_idx[k][i] = *it; //col k nonzero indices of L are stored
 					L.m_x[k][i] = work[*it]/D[k]; //col k nonzero values of L are stored
 
-					L.list[*it].push_back(k); //update Llist
+					list_push(*it, k); //update Llist
 					count++;
 					i++;
 				}
@@ -380,6 +606,8 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 			advance_list(k);
 		} else {
 			//resize k+1th column of L to proper size.
+			L.m_idx[k+1].reserve(temp_nnzs.size()+1);
+			L.m_x[k+1].reserve(temp_nnzs.size()+1);
 			L.m_idx[k+1].resize(temp_nnzs.size()+1);
 			L.m_x[k+1].resize(temp_nnzs.size()+1);
 
@@ -394,7 +622,7 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 					L.m_x[k][i] = work[*it]; //col k nonzero indices of L are stored
 					L.m_idx[k][i] = *it; //col k nonzero values of L are stored
 					
-					L.list[*it].push_back(k); //update L.list
+					list_push(*it, k); //update L.list
 					count++;
 					i++;
 				}
@@ -407,7 +635,7 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 					L.m_x[k+1][j] = temp[*it]; //col k+1 nonzero indices of L are stored
 					L.m_idx[k+1][j] = *it; //col k+1 nonzero values of L are stored
 					
-					L.list[*it].push_back(k+1); //update L.list
+					list_push(*it, k+1); //update L.list
 					count++;
 					j++;
 				}
@@ -444,22 +672,87 @@ void lilc_matrix<el_type> :: ildl(lilc_matrix<el_type>& L, block_diag_matrix<el_
 		
 		//-------------------------------------------------------------------//
 		
+		//keep track of the inertia of D if we are to stop early (see max_neg_pivots)
+		if (max_neg_pivots >= 0) {
+			D.block_inertia(k, num_pos_pivots, num_neg_pivots, num_zero_pivots);
+		}
+		
 		//resize columns of L to correct size
+		const int k0 = k;
 		L.m_x[k].resize(col_size);
 		L.m_idx[k].resize(col_size);
+		
+		//account for columns that outgrew what was reserved for them
+		bytes += (L.m_idx[k].capacity() - col_count[k])*(sizeof(int) + sizeof(el_type));
 
 		if (size_two_piv) {
 			L.m_x[k+1].resize(col_size2);
 			L.m_idx[k+1].resize(col_size2);
+			bytes += d_bytes;
+			bytes += (L.m_idx[k+1].capacity() - col_count[k+1])*(sizeof(int) + sizeof(el_type));
 			k++;
 			
 			size_two_piv = false;
 		}
+		peak_bytes = std::max(peak_bytes, used());
+		
+		//the largest entry of L measures the growth in the factorization (see
+		//pivot_growth). it is taken as columns are finished, as they may be evicted.
+		for (j = k0; j <= k; j++) {
+			for (i = 1; i < (int) L.m_x[j].size(); i++) {
+				pivot_growth = std::max(pivot_growth, (double) abs(L.m_x[j][i]));
+			}
+		}
+		
+		//out of core, a column with no rows left below k will not be read again by
+		//the factorization, so it is handed to L.ooc to be evicted. such columns are
+		//either the ones just formed, or have their last row in k0:k (and are in
+		//L.list). the row lists are not needed after this either.
+		if (out_of_core) {
+			for (j = k0; j <= k; j++) {
+				for (idx_it it = L.list[j].begin(); it != L.list[j].end(); it++) {
+					if (L.col_first[*it] >= (int) L.m_idx[*it].size()) L.ooc->retire(*it, L.m_idx, L.m_x);
+				}
+				bytes -= L.list[j].capacity()*sizeof(int);
+				idx_vector_type().swap(L.list[j]);
+				if (L.col_first[j] >= (int) L.m_idx[j].size()) L.ooc->retire(j, L.m_idx, L.m_x);
+			}
+		}
+		
+		//the inertia is already known to be wrong, so the rest of the work is wasted
+		if (max_neg_pivots >= 0 && num_neg_pivots > max_neg_pivots) break;
+		
+		//the work vectors are all zero again here, so the state of the factorization
+		//is just the matrices and the counters.
+		if (checkpointing && k+1 < ncols && std::chrono::steady_clock::now() >= next_checkpoint) {
+			st.k = k+1;
+			st.count = count;
+			st.num_perturbed = num_perturbed;
+			st.num_pos_pivots = num_pos_pivots;
+			st.num_neg_pivots = num_neg_pivots;
+			st.num_zero_pivots = num_zero_pivots;
+			st.pivot_growth = pivot_growth;
+			st.bytes = bytes;
+			st.peak_bytes = peak_bytes;
+			st.col_count.swap(col_count);
+			st.list_capacity.resize(ncols);
+			for (j = 0; j < ncols; j++) st.list_capacity[j] = L.list[j].capacity();
+			save_checkpoint(L, D, perm, st, key);
+			col_count.swap(st.col_count);
+			next_checkpoint = std::chrono::steady_clock::now() + std::chrono::duration<double>(checkpoint_interval);
+		}
 	}
+	
+	//a finished factorization has no use for its checkpoint
+	if (checkpointing) std::remove(checkpoint_file.c_str());
 
 	//assign number of non-zeros in L to L.nnz_count
 	L.nnz_count = count;
 
+	//the evicted columns are put in column order on disk, which is the order
+	//the solves read them in
+	if (out_of_core) L.ooc->reorder();
+
 }
 
 #endif
@@ -23,7 +23,7 @@ inline double dot_product(const vector<el_type>& v, const vector<el_type>& w) {
 	\param u the storage vector for the result
 */
 template <class el_type>
-inline void vector_sum(double a, vector<el_type>& v, double b, vector<el_type>& w, vector<el_type>& u) {
+inline void vector_sum(double a, const vector<el_type>& v, double b, const vector<el_type>& w, vector<el_type>& u) {
 	for (int i = 0; i < v.size(); i++) {
 		u[i] = a*v[i] + b*w[i];
 	}
@@ -71,7 +71,7 @@ inline double norm(vector<el_type>& v, vector<int>& curr_nnzs, el_type p = 1) {
 	\return the norm of v.
 */
 template <class el_type>
-inline double norm(vector<el_type>& v, el_type p = 1) { 
+inline double norm(const vector<el_type>& v, el_type p = 1) { 
 	el_type res = 0;
 	for (int i = 0; i < v.size(); i++) {
 		res += pow(abs(v[i]), p);
@@ -220,7 +220,7 @@ inline void update_single(const int& k, const int& j, const el_type& l_ki, const
 	\param in_set temporary storage for use in merging two lists of nonzero indices.
 */
 template <class el_type>
-inline void update(const int& r, vector<el_type>& work, vector<int>& curr_nnzs, lilc_matrix<el_type>& L, block_diag_matrix<el_type>& D, vector<bool>& in_set) {
+inline void update(const int& r, vector<el_type>& work, vector<int>& curr_nnzs, lilc_matrix<el_type>& L, const block_diag_matrix<el_type>& D, vector<bool>& in_set) {
 	unsigned int j;
 	int blk_sz;
 	el_type d_12, l_ri;	
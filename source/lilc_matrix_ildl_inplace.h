@@ -7,7 +7,7 @@ using std::cout;
 using std::abs;
 
 template <class el_type>
-void lilc_matrix<el_type> :: ildl_inplace(block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type)
+void lilc_matrix<el_type> :: ildl_inplace(block_diag_matrix<el_type>& D, idx_vector_type& perm, const double& fill_factor, const double& tol, const double& pp_tol, int piv_type, ildl_workspace<el_type>* ws)
 {
 
 	//----------------- initialize temporary variables --------------------//
@@ -22,15 +22,43 @@ void lilc_matrix<el_type> :: ildl_inplace(block_diag_matrix<el_type>& D, idx_vec
 	el_type det_D, D_inv11, D_inv22, D_inv12;	//for use in 2x2 pivots
 	el_type l_11, l_12;							//for use in 2x2 pivots
 
-	vector<bool> in_set(ncols, false); //bitset used for unsorted merges
-	swap_struct<el_type> s;	//struct containing temp vars used in pivoting.
+	//the work vectors are taken from ws if given (see ildl_workspace), and are
+	//otherwise allocated for this call only.
+	ildl_workspace<el_type> own_ws;
+	ildl_workspace<el_type>& w = (ws ? *ws : own_ws);
+	w.resize(ncols);
 	
-	elt_vector_type work(ncols, 0), temp(ncols, 0); ////work vector for the current column
-	idx_vector_type curr_nnzs, temp_nnzs;  //non-zeros on current col.
-	curr_nnzs.reserve(ncols); //reserves space for worse case (entire col is non-zero)
+	vector<bool>& in_set = w.in_set; //bitset used for unsorted merges
+	swap_struct<el_type>& s = w.s;	//struct containing temp vars used in pivoting.
+	
+	elt_vector_type& work = w.work, & temp = w.temp; //work vector for the current column
+	idx_vector_type& curr_nnzs = w.curr_nnzs, & temp_nnzs = w.temp_nnzs;  //non-zeros on current col.
 
-	int count = 0; //the total number of nonzeros stored in L.
 	int i, j, k, r, offset, col_size, col_size2(-1);
+
+	//static pivoting never swaps rows, so tiny pivots are perturbed instead (to
+	//sqrt(eps)*||A|| in the max norm, or sqrt(eps)*||A||^2 for the determinant of a
+	//2x2 pivot, which scales with ||A||^2). other pivoting schemes set any pivot or
+	//determinant below eps to 1e-6.
+	//note that only 1x1 pivots are used by static pivoting in the inplace factorization.
+	const bool static_piv = (piv_type == pivot_type::STATIC);
+	el_type max_A = 0;
+	if (static_piv) {
+		for (k = 0; k < ncols; k++) {
+			for (elt_it it = m_x[k].begin(); it != m_x[k].end(); it++) {
+				max_A = std::max(max_A, (el_type) abs(*it));
+			}
+		}
+	}
+	const el_type piv_tol = (static_piv ? sqrt(std::numeric_limits<el_type>::epsilon())*max_A : eps);
+	const el_type piv_pert = (static_piv ? piv_tol : 1e-6);
+	const el_type det_tol = (static_piv ? piv_tol*max_A : eps);
+	const el_type det_pert = (static_piv ? det_tol : 1e-6);
+	num_perturbed = 0;
+	num_neg_pivots = 0;
+	int num_pos_pivots = 0, num_zero_pivots = 0;
+
+	int count = 0; //the total number of nonzeros stored in L.
 	bool size_two_piv = false;	//boolean indicating if the pivot is 2x2 or 1x1
 
 	//--------------- allocate memory for L and D ------------------//
@@ -304,7 +332,10 @@ void lilc_matrix<el_type> :: ildl_inplace(block_diag_matrix<el_type>& D, idx_vec
 			
 			//compute inverse of the 2x2 block diagonal pivot.
 			det_D = d1*dr - work[k+1]*work[k+1];
-			if ( abs(det_D) < eps) det_D = 1e-6;  //statically pivot;
+			if ( abs(det_D) < det_tol) { //statically pivot
+				det_D = (static_piv && det_D < 0 ? -det_pert : det_pert);
+				num_perturbed++;
+			}
 			D_inv11 = dr/det_D;
 			D_inv22 = d1/det_D;
 			D_inv12 = -work[k+1]/det_D;
@@ -362,7 +393,10 @@ void lilc_matrix<el_type> :: ildl_inplace(block_diag_matrix<el_type>& D, idx_vec
 		count++;
 		
 		if (!size_two_piv) {
-			if ( abs(D[k]) < eps) D[k] = 1e-6; //statically pivot
+			if ( abs(D[k]) < piv_tol) { //statically pivot
+				D[k] = (static_piv && D[k] < 0 ? -piv_pert : piv_pert);
+				num_perturbed++;
+			}
 			i = 1;
             
 			for (idx_it it = curr_nnzs.begin(); it != curr_nnzs.end(); it++) { 
@@ -451,6 +485,11 @@ void lilc_matrix<el_type> :: ildl_inplace(block_diag_matrix<el_type>& D, idx_vec
 		
 		//-------------------------------------------------------------------//
 		
+		//keep track of the inertia of D if we are to stop early (see max_neg_pivots)
+		if (max_neg_pivots >= 0) {
+			D.block_inertia(k, num_pos_pivots, num_neg_pivots, num_zero_pivots);
+		}
+		
 		//resize columns of L to correct size
 		m_x[k].resize(col_size);
 		m_idx[k].resize(col_size);
@@ -472,10 +511,21 @@ void lilc_matrix<el_type> :: ildl_inplace(block_diag_matrix<el_type>& D, idx_vec
 			
 			size_two_piv = false;
 		}
+		
+		//the inertia is already known to be wrong, so the rest of the work is wasted
+		if (max_neg_pivots >= 0 && num_neg_pivots > max_neg_pivots) break;
 	}
 
 	//assign number of non-zeros in L to L.nnz_count
 	this->nnz_count = count;
+	
+	//the largest entry of L measures the growth in the factorization (see pivot_growth)
+	pivot_growth = 0;
+	for (k = 0; k < ncols; k++) {
+		for (i = 1; i < (int) m_x[k].size(); i++) {
+			pivot_growth = std::max(pivot_growth, (double) abs(m_x[k][i]));
+		}
+	}
 }
 
 #endif
@@ -18,22 +18,38 @@ bool lilc_matrix<el_type> :: save(std::string filename, bool sym)
 	if(!out)
 	return false;
 
-	out.flags(std::ios_base::scientific);
-	out.precision(16);
 	std::string header; 
 	put_header(header, sym); 
 
-	out << header << std::endl; 
+	out << header << "\n"; 
 	out << n_rows() << " " << n_cols() << " " << nnz() << "\n";
 
-	for(int i = 0; i < n_cols(); i++) {
-		for(unsigned int j = 0; j < m_idx[i].size(); j++) {
-			out << m_idx[i][j]+1 << " " << i+1 << " " << m_x[i][j] << "\n";
+	//the columns are cut into chunks of about mtx_chunk_entries entries each,
+	//which are formatted in parallel
+	vector<int> first(1, 0);
+	for (int i = 0, count = 0; i < n_cols(); i++) {
+		count += (ooc && ooc->state[i] == 2 ? ooc->len[i] : (int) m_idx[i].size());
+		if (count >= mtx_chunk_entries || i == n_cols()-1) {
+			first.push_back(i+1);
+			count = 0;
 		}
 	}
+
+	//columns evicted to disk (see ooc_file) are read back one at a time,
+	//through a buffer that cannot be shared between threads
+	std::unique_lock<std::mutex> guard = ooc_lock();
+	bool ok = mtx_write_chunks(out, first.size()-1, [&](int c, std::string& buf) {
+		const int* idx; const el_type* x; int len;
+		for (int i = first[c]; i < first[c+1]; i++) {
+			column(i, idx, x, len);
+			for (int j = 0; j < len; j++) {
+				mtx_put_entry(buf, idx[j]+1, i+1, x[j]);
+			}
+		}
+	}, !ooc);
 	
 	out.close();
-	return true;
+	return ok && !out.fail();
 }
 
 #endif
@@ -0,0 +1,138 @@
+// -*- mode: c++ -*-
+#ifndef _LILC_MATRIX_SELECTED_INVERSE_H_
+#define _LILC_MATRIX_SELECTED_INVERSE_H_
+
+template<class el_type>
+void lilc_matrix<el_type> :: selected_inverse(const block_diag_matrix<el_type>& D, lilc_matrix<el_type>& Z) const {
+	const int n = m_n_cols;
+	int i, j, k, p, t;
+
+	// the pivot blocks of D. block b is made of columns first[b] (and first[b]+1 if it is 2x2).
+	vector<int> first, blk(n);
+	for (k = 0; k < n; k += (D.block_size(k) == 2 ? 2 : 1)) {
+		for (j = k; j < k + (D.block_size(k) == 2 ? 2 : 1); j++) blk[j] = first.size();
+		first.push_back(k);
+	}
+	const int nb = first.size();
+	auto last = [&](int b) { return (b+1 < nb ? first[b+1] : n) - 1; };
+
+	// ---------- symbolic phase ----------//
+	// with dropping, the pattern of L is not closed under elimination, so the
+	// takahashi equations would need entries of Z outside of it. the pattern of Z is
+	// the filled pattern of L: the rows of a block are its own rows in L, together
+	// with the rows of its children in the (block) elimination tree.
+	Z.resize(n, n);
+	vector<int> mark(n, -1), head(nb, -1), next(nb, -1);
+	vector<int> rows;
+	for (int b = 0; b < nb; b++) {
+		const int c0 = first[b], c1 = last(b);
+		rows.clear();
+		for (j = c0; j <= c1; j++) {
+			for (p = 1; p < (int) m_idx[j].size(); p++) {
+				i = m_idx[j][p];
+				if (i > c1 && mark[i] != b) {
+					mark[i] = b;
+					rows.push_back(i);
+				}
+			}
+		}
+		for (int c = head[b]; c != -1; c = next[c]) {
+			const idx_vector_type& crows = Z.m_idx[first[c]];
+			for (p = 0; p < (int) crows.size(); p++) {
+				i = crows[p];
+				if (i > c1 && mark[i] != b) {
+					mark[i] = b;
+					rows.push_back(i);
+				}
+			}
+		}
+		std::sort(rows.begin(), rows.end());
+
+		// the diagonal comes first in each column of Z, as in L, followed by the
+		// other entry of a 2x2 block and then the filled rows of the block.
+		for (j = c0; j <= c1; j++) {
+			Z.m_idx[j].reserve(rows.size() + c1 - j + 1);
+			for (i = j; i <= c1; i++) Z.m_idx[j].push_back(i);
+			Z.m_idx[j].insert(Z.m_idx[j].end(), rows.begin(), rows.end());
+			Z.m_x[j].assign(Z.m_idx[j].size(), 0);
+		}
+
+		if (!rows.empty()) {
+			int parent = blk[rows[0]];
+			next[b] = head[parent];
+			head[parent] = b;
+		}
+	}
+
+	// ---------- numeric phase ----------//
+	// for each block J (last to first) with filled rows I, the takahashi equations
+	// Z = D^(-1) L^(-1) + (I - L')Z give
+	//		Z(I, J) = -Z(I, I) * L(I, J),
+	//		Z(J, J) = D(J, J)^(-1) - L(I, J)' * Z(I, J).
+	// Z(I, I) is known, since I only contains rows of later blocks.
+	vector<int> pos(n, -1);
+	vector<el_type> l[2], y[2];
+	for (int b = nb-1; b >= 0; b--) {
+		const int c0 = first[b], c1 = last(b), bs = c1 - c0 + 1;
+		const idx_vector_type& I = Z.m_idx[c1];
+		const int m = I.size() - 1; // I[0] = c1 is the diagonal
+		for (t = 1; t <= m; t++) pos[I[t]] = t-1;
+
+		for (j = 0; j < bs; j++) {
+			l[j].assign(m, 0);
+			y[j].assign(m, 0);
+			const int c = c0 + j;
+			for (p = 1; p < (int) m_idx[c].size(); p++) {
+				i = m_idx[c][p];
+				if (pos[i] >= 0) l[j][pos[i]] = m_x[c][p];
+			}
+
+			// y = Z(I, I) * L(I, c), using the lower triangle of Z(I, I) stored by column
+			for (t = 0; t < m; t++) {
+				const int col = I[t+1];
+				const idx_vector_type& zi = Z.m_idx[col];
+				const elt_vector_type& zx = Z.m_x[col];
+				y[j][t] += zx[0]*l[j][t];
+				for (p = 1; p < (int) zi.size(); p++) {
+					k = pos[zi[p]];
+					if (k < 0) continue;
+					y[j][k] += zx[p]*l[j][t];
+					y[j][t] += zx[p]*l[j][k];
+				}
+			}
+		}
+
+		// Z(J, J) = D(J, J)^(-1) + L(I, J)' * y
+		if (bs == 1) {
+			double zjj = 1.0/D[c0];
+			for (t = 0; t < m; t++) zjj += l[0][t]*y[0][t];
+			Z.m_x[c0][0] = zjj;
+		} else {
+			double a = D[c0], d = D[c1], c = D.off_diagonal(c0);
+			double det = a*d - c*c;
+			double z00 = d/det, z10 = -c/det, z11 = a/det;
+			for (t = 0; t < m; t++) {
+				z00 += l[0][t]*y[0][t];
+				z10 += l[1][t]*y[0][t];
+				z11 += l[1][t]*y[1][t];
+			}
+			Z.m_x[c0][0] = z00;
+			Z.m_x[c0][1] = z10;
+			Z.m_x[c1][0] = z11;
+		}
+
+		// Z(I, J) = -y
+		for (j = 0; j < bs; j++) {
+			elt_vector_type& zx = Z.m_x[c0 + j];
+			const int off = bs - j; // the diagonal (and 2x2) entries come first
+			for (t = 0; t < m; t++) zx[off + t] = -y[j][t];
+		}
+
+		for (t = 1; t <= m; t++) pos[I[t]] = -1;
+	}
+
+	Z.nnz_count = 0;
+	for (j = 0; j < n; j++) Z.nnz_count += Z.m_idx[j].size();
+}
+
+#endif
@@ -0,0 +1,71 @@
+// -*- mode: c++ -*-
+#ifndef _LILC_MATRIX_SPARSE_SOLVE_H_
+#define _LILC_MATRIX_SPARSE_SOLVE_H_
+
+template<class el_type>
+void lilc_matrix<el_type> :: reach(const idx_vector_type& b_idx, bool transposed, idx_vector_type& xi, vector<bool>& marked, idx_vector_type& stack) const {
+	xi.clear();
+	if ((int) stack.size() < 2*m_n_cols) stack.resize(2*m_n_cols);
+
+	// non-recursive depth first search from each nonzero of b. stack holds pairs of
+	// (node, position in its adjacency list). nodes are appended to xi once all of
+	// their successors are done, so xi ends up in reverse topological order.
+	for (int t = 0; t < (int) b_idx.size(); t++) {
+		if (marked[b_idx[t]]) continue;
+
+		int top = 0;
+		stack[0] = b_idx[t]; stack[1] = 0;
+		marked[b_idx[t]] = true;
+		while (top >= 0) {
+			const int j = stack[2*top];
+			const idx_vector_type& adj = (transposed ? list[j] : m_idx[j]);
+
+			int p = stack[2*top+1];
+			while (p < (int) adj.size() && (adj[p] == j || marked[adj[p]])) p++;
+
+			if (p == (int) adj.size()) {
+				xi.push_back(j);
+				top--;
+			} else {
+				stack[2*top+1] = p+1;
+				top++;
+				stack[2*top] = adj[p]; stack[2*top+1] = 0;
+				marked[adj[p]] = true;
+			}
+		}
+	}
+
+	std::reverse(xi.begin(), xi.end());
+	for (int t = 0; t < (int) xi.size(); t++) marked[xi[t]] = false;
+}
+
+template<class el_type>
+void lilc_matrix<el_type> :: sparse_backsolve(const idx_vector_type& b_idx, elt_vector_type& x, idx_vector_type& xi, vector<bool>& marked, idx_vector_type& stack) const {
+	reach(b_idx, false, xi, marked, stack);
+
+	// forward substitution over the reached columns only, in topological order
+	for (int t = 0; t < (int) xi.size(); t++) {
+		const int i = xi[t];
+		x[i] /= m_x[i][0];
+		for (int k = 1; k < (int) m_idx[i].size(); k++) {
+			x[m_idx[i][k]] -= x[i]*m_x[i][k];
+		}
+	}
+}
+
+template<class el_type>
+void lilc_matrix<el_type> :: sparse_forwardsolve(const idx_vector_type& b_idx, elt_vector_type& x, idx_vector_type& xi, vector<bool>& marked, idx_vector_type& stack) const {
+	reach(b_idx, true, xi, marked, stack);
+
+	// back substitution over the reached rows only. x is zero outside of xi, so
+	// the unreached entries of each column contribute nothing.
+	for (int t = 0; t < (int) xi.size(); t++) {
+		const int i = xi[t];
+		x[i] = x[i]/m_x[i][0];
+		for (int k = 1; k < (int) m_idx[i].size(); k++) {
+			x[i] -= x[m_idx[i][k]]*m_x[i][k]/m_x[i][0];
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,468 @@
+//-*- mode: c++ -*-
+#ifndef _LIL_MATRIX_SYM_AMD_PAR_H_
+#define _LIL_MATRIX_SYM_AMD_PAR_H_
+
+#include <climits>
+
+namespace amd {
+	/* atomically read *addr */
+	inline int atomic_get(const int* addr)
+	{
+		return __atomic_load_n(addr, __ATOMIC_RELAXED);
+	}
+
+	/* atomically set *addr = val */
+	inline void atomic_set(int* addr, int val)
+	{
+		__atomic_store_n(addr, val, __ATOMIC_RELAXED);
+	}
+
+	/* atomically set *addr = min(*addr, val) */
+	inline void atomic_min(int* addr, int val)
+	{
+		int old = atomic_get(addr);
+		while (val < old && !__sync_bool_compare_and_swap(addr, old, val))
+			old = atomic_get(addr);
+	}
+
+	/* set *addr = val unless *addr is locked (-1). other candidates may release
+	   the same node concurrently, so both the test and the store are atomic. */
+	inline void set_unlocked(int* addr, int val)
+	{
+		if (atomic_get(addr) != -1) atomic_set(addr, val);
+	}
+
+	/* scrambles i so that ties in degree are broken pseudo-randomly */
+	inline unsigned int scramble(unsigned int i)
+	{
+		i = ((i >> 16) ^ i) * 0x45d9f3b;
+		i = ((i >> 16) ^ i) * 0x45d9f3b;
+		return (i >> 16) ^ i;
+	}
+
+	/* orders candidate pivots by approximate degree, then pseudo-randomly */
+	struct by_degree_index
+	{
+		const vector<int>& degree;
+		by_degree_index(const vector<int>& d) : degree(d) {}
+		bool operator()(int a, int b) const {
+			if (degree[a] != degree[b]) return degree[a] < degree[b];
+			unsigned int ha = scramble(a), hb = scramble(b);
+			if (ha != hb) return ha < hb;
+			return a < b;
+		}
+	};
+
+	/* outcome of a candidate in the independent set selection */
+	enum { UNDECIDED, WON, BLOCKED };
+
+	/* states of a node in the quotient graph */
+	enum { LIVE, ELEMENT, DEAD };
+}
+
+/*  Multiple elimination variant of sym_amd() (experimental: it does 8-10 times the
+	work of sym_amd(), and has not yet been measured to be faster with more threads).
+
+	Each round, all live variables whose approximate degree is within a factor
+	relax of the minimum are candidates. A distance-2 independent subset of them
+	is chosen (no two pivots share a variable in their reach) by letting every
+	candidate claim its reach with an atomic min on its rank; the candidates that
+	own their whole reach are eliminated together. Since their reaches are
+	disjoint, each pivot's element construction, absorption, list pruning and
+	supervariable detection only touch its own nodes and run in parallel.
+
+	Degrees use the same bound as sym_amd(),
+		d(i) = min(n - nel, d_old(i) + |Lp\i|, |Ai| + |Lp\i| + sum_e |Le\Lp|),
+	but the set differences |Le\Lp| are counted in per-thread arrays instead of the
+	shared w array, and the bound is relaxed to n - nel at the start of the round.
+
+	The assembly tree is postordered exactly like sym_amd().
+*/
+template<class el_type>
+inline void lilc_matrix<el_type> :: sym_amd_par(vector<int>& perm, double relax) {
+	using std::sqrt;
+	using std::min;
+	using std::max;
+
+	//on one thread the rounds only add work (about 10x that of sym_amd()), so
+	//the sequential ordering is used instead.
+	if (bfs_struct::num_threads() == 1) {
+		sym_amd(perm);
+		return;
+	}
+
+	const int n = this->n_rows();
+	perm.resize(n);
+	if (n == 0) return;
+
+	int dense = max(16, int(10 * sqrt(double(n))));   /* find dense threshold */
+	dense = min(n-2, dense);
+
+	vector<idx_vector_type> adj(n);     /* Ai: variables adjacent to i */
+	vector<idx_vector_type> elems(n);   /* Ei: elements adjacent to i */
+	vector<idx_vector_type> lk(n);      /* Le: variables in element e */
+
+	vector<int> nv(n+1, 1), degree(n, 0), esize(n, 0);
+	vector<int> parent(n+1, -1), owner(n, INT_MAX), lp_of(n, -1);
+	vector<char> status(n, amd::LIVE);
+
+	int i, nel = 0;
+
+	/* --- Build quotient graph in parallel --------------------------------- */
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (i = 0; i < n; i++) {
+		adj[i].reserve(list[i].size() + m_idx[i].size());
+		adj[i].assign(list[i].begin(), list[i].end());
+		for (idx_it it = m_idx[i].begin(); it != m_idx[i].end(); it++) {
+			if (*it != i) adj[i].push_back(*it);
+		}
+		degree[i] = adj[i].size();
+	}
+
+	/* degree lists. entries are removed lazily: an entry v in bucket[d] is
+	   stale once v is no longer live or its degree is no longer d. */
+	vector<idx_vector_type> bucket(n+1);
+	vector<int> seen(n, -1);
+	int mindeg = n;
+	for (i = 0; i < n; i++) {
+		if (degree[i] == 0) {                  /* node i is empty */
+			status[i] = amd::ELEMENT;          /* i is a root of assembly tree */
+			nel++;
+		} else if (degree[i] > dense) {        /* node i is dense */
+			status[i] = amd::DEAD;             /* absorb i into element n */
+			nv[i] = 0;
+			parent[i] = n;
+			nv[n]++;
+			nel++;
+		} else {
+			bucket[degree[i]].push_back(i);
+			mindeg = min(mindeg, degree[i]);
+		}
+	}
+
+	const int max_passes = 8, min_cand = 4*bfs_struct::num_threads();
+	int cand_limit = n;
+	vector<int> cand, winners, active;
+	vector<char> won;
+	vector< vector<int> > w_of(bfs_struct::num_threads()), mark_of(bfs_struct::num_threads());
+	amd::by_degree_index sorter(degree);
+
+	for (int round = 0; nel < n; round++) {
+		/* --- Select pivot candidates -------------------------------------- */
+		//once elements grow large most candidates conflict, so only gather a
+		//few more than the last round managed to eliminate.
+		int d, threshold = n;
+		cand.clear();
+		for (d = mindeg; d <= threshold && (int) cand.size() < cand_limit; d++) {
+			idx_vector_type& bd = bucket[d];
+			int cnt = 0;
+			for (idx_it it = bd.begin(); it != bd.end(); it++) {
+				if (status[*it] != amd::LIVE || degree[*it] != d || seen[*it] == round) continue;
+				seen[*it] = round;
+				bd[cnt++] = *it;
+			}
+			bd.resize(cnt);
+
+			if (cand.empty() && cnt > 0) {
+				mindeg = d;
+				threshold = min(n, max(d, int(relax * d)));
+			}
+			cand.insert(cand.end(), bd.begin(), bd.end());
+		}
+		if (cand.empty()) break;
+		std::sort(cand.begin(), cand.end(), sorter);
+		if ((int) cand.size() > cand_limit) cand.resize(cand_limit);
+
+		/* --- Distance-2 independent set: claim reaches by rank ------------ */
+		// Luby-style: every undecided candidate claims its reach with its rank,
+		// candidates owning their whole reach win and lock it, candidates touching
+		// a locked node are blocked, and the rest release their claims and retry.
+		// Ranks are pseudo-random within a degree, so only a few passes are needed.
+		const int nc = cand.size();
+		won.assign(nc, amd::UNDECIDED);
+		active.resize(nc);
+		for (i = 0; i < nc; i++) active[i] = i;
+
+		if (nc == 1) {
+			won[0] = amd::WON;
+			active.clear();
+		}
+
+		for (int pass = 0; pass < max_passes && !active.empty(); pass++) {
+			const int na = active.size();
+			#pragma omp parallel for schedule(dynamic, 16)
+			for (i = 0; i < na; i++) {
+				int c = active[i], p = cand[c];
+				amd::atomic_min(&owner[p], c);
+				for (idx_it it = adj[p].begin(); it != adj[p].end(); it++) {
+					if (status[*it] == amd::LIVE) amd::atomic_min(&owner[*it], c);
+				}
+				for (idx_it et = elems[p].begin(); et != elems[p].end(); et++) {
+					for (idx_it it = lk[*et].begin(); it != lk[*et].end(); it++) {
+						if (status[*it] == amd::LIVE) amd::atomic_min(&owner[*it], c);
+					}
+				}
+			}
+
+			#pragma omp parallel for schedule(dynamic, 16)
+			for (i = 0; i < na; i++) {
+				int c = active[i], p = cand[c];
+				char res = (owner[p] == c ? amd::WON : amd::UNDECIDED);
+				if (owner[p] == -1) res = amd::BLOCKED;
+				for (idx_it it = adj[p].begin(); res != amd::BLOCKED && it != adj[p].end(); it++) {
+					if (status[*it] != amd::LIVE) continue;
+					if (owner[*it] == -1) res = amd::BLOCKED;
+					else if (owner[*it] != c) res = amd::UNDECIDED;
+				}
+				for (idx_it et = elems[p].begin(); res != amd::BLOCKED && et != elems[p].end(); et++) {
+					for (idx_it it = lk[*et].begin(); res != amd::BLOCKED && it != lk[*et].end(); it++) {
+						if (status[*it] != amd::LIVE) continue;
+						if (owner[*it] == -1) res = amd::BLOCKED;
+						else if (owner[*it] != c) res = amd::UNDECIDED;
+					}
+				}
+				won[c] = res;
+			}
+
+			//lock the reach of the winners, then release the claims of everyone else
+			for (int lock = 1; lock >= 0; lock--) {
+				#pragma omp parallel for schedule(dynamic, 16)
+				for (i = 0; i < na; i++) {
+					int c = active[i], p = cand[c];
+					if ((won[c] == amd::WON) != (lock == 1)) continue;
+
+					int val = (lock ? -1 : INT_MAX);
+					amd::set_unlocked(&owner[p], val);
+					for (idx_it it = adj[p].begin(); it != adj[p].end(); it++) {
+						if (status[*it] == amd::LIVE) amd::set_unlocked(&owner[*it], val);
+					}
+					for (idx_it et = elems[p].begin(); et != elems[p].end(); et++) {
+						for (idx_it it = lk[*et].begin(); it != lk[*et].end(); it++) {
+							if (status[*it] == amd::LIVE) amd::set_unlocked(&owner[*it], val);
+						}
+					}
+				}
+			}
+
+			int cnt = 0;
+			for (i = 0; i < na; i++) {
+				if (won[active[i]] == amd::UNDECIDED) active[cnt++] = active[i];
+			}
+			active.resize(cnt);
+		}
+
+		winners.clear();
+		for (i = 0; i < nc; i++) {
+			if (won[i] == amd::WON) winners.push_back(cand[i]);
+		}
+		const int nw = winners.size();
+		cand_limit = max(min_cand, 4*nw);
+
+		/* --- Construct new elements and absorb adjacent ones --------------- */
+		#pragma omp parallel for schedule(dynamic, 4)
+		for (i = 0; i < nw; i++) {
+			int p = winners[i], dk = 0;
+			idx_vector_type& Lp = lk[p];
+			Lp.clear();
+			lp_of[p] = p;
+
+			for (idx_it it = adj[p].begin(); it != adj[p].end(); it++) {
+				if (status[*it] == amd::LIVE && lp_of[*it] != p) {
+					lp_of[*it] = p;
+					Lp.push_back(*it);
+					dk += nv[*it];
+				}
+			}
+
+			for (idx_it et = elems[p].begin(); et != elems[p].end(); et++) {
+				for (idx_it it = lk[*et].begin(); it != lk[*et].end(); it++) {
+					if (status[*it] == amd::LIVE && lp_of[*it] != p) {
+						lp_of[*it] = p;
+						Lp.push_back(*it);
+						dk += nv[*it];
+					}
+				}
+				parent[*et] = p;                  /* absorb e into p */
+				idx_vector_type().swap(lk[*et]);
+			}
+
+			status[p] = amd::ELEMENT;
+			esize[p] = dk;
+			idx_vector_type().swap(adj[p]);
+			idx_vector_type().swap(elems[p]);
+		}
+
+		/* --- Prune lists and update degrees of the variables in each Lp ---- */
+		#pragma omp parallel
+		{
+			vector<int>& wext = w_of[bfs_struct::thread_id()];   /* |Le \ Lp| of element e */
+			vector<int>& wmark = mark_of[bfs_struct::thread_id()];   /* wext[e] is set iff wmark[e] == p */
+			if (wext.empty()) {
+				wext.resize(n);
+				wmark.assign(n, -1);
+			}
+
+			#pragma omp for schedule(dynamic, 4)
+			for (i = 0; i < nw; i++) {
+				int p = winners[i], dk = esize[p];
+				idx_vector_type& Lp = lk[p];
+
+				// scan 1: find |Le\Lp|. an element only touched by Lp belongs to this
+				// pivot alone, so absorbing it below cannot race with other pivots.
+				for (idx_it vt = Lp.begin(); vt != Lp.end(); vt++) {
+					for (idx_it et = elems[*vt].begin(); et != elems[*vt].end(); et++) {
+						if (parent[*et] == p) continue;
+						if (wmark[*et] != p) {
+							wmark[*et] = p;
+							wext[*et] = esize[*et] - nv[*vt];
+						} else {
+							wext[*et] -= nv[*vt];
+						}
+					}
+				}
+
+				// scan 2: prune lists and update degrees
+				for (idx_it vt = Lp.begin(); vt != Lp.end(); vt++) {
+					int v = *vt, da = 0, de = 0, j, cnt;
+					idx_vector_type& Ev = elems[v];
+					idx_vector_type& Av = adj[v];
+
+					for (j = 0, cnt = 0; j < (int) Ev.size(); j++) {
+						int e = Ev[j];
+						if (parent[e] == p) continue;      /* absorbed into p */
+						int dext = wext[e];
+						if (dext <= 0) {
+							parent[e] = p;                 /* aggressive absorb. e->p */
+							idx_vector_type().swap(lk[e]);
+							continue;
+						}
+						de += dext;
+						Ev[cnt++] = e;
+					}
+					Ev.resize(cnt);
+					Ev.push_back(p);
+
+					for (j = 0, cnt = 0; j < (int) Av.size(); j++) {
+						if (status[Av[j]] != amd::LIVE || lp_of[Av[j]] == p) continue;
+						da += nv[Av[j]];
+						Av[cnt++] = Av[j];
+					}
+					Av.resize(cnt);
+
+					int d = min(degree[v] + dk - nv[v], da + dk - nv[v] + de);
+					degree[v] = max(0, min(d, n - nel - nv[v]));
+				}
+			}
+		}
+
+		/* --- Mass elimination and supervariable detection ------------------ */
+		int eliminated = 0;
+		#pragma omp parallel reduction(+:eliminated)
+		{
+			vector< std::pair<long long, int> > keys;
+
+			#pragma omp for schedule(dynamic, 4)
+			for (i = 0; i < nw; i++) {
+				int p = winners[i];
+				idx_vector_type& Lp = lk[p];
+
+				keys.clear();
+				for (idx_it vt = Lp.begin(); vt != Lp.end(); vt++) {
+					int v = *vt;
+					if (adj[v].empty() && elems[v].size() == 1) {
+						parent[v] = p;                 /* absorb v into p */
+						nv[p] += nv[v];
+						esize[p] -= nv[v];
+						nv[v] = 0;
+						status[v] = amd::DEAD;
+						idx_vector_type().swap(elems[v]);
+						continue;
+					}
+
+					long long h = 0;
+					for (idx_it it = adj[v].begin(); it != adj[v].end(); it++) h += *it;
+					for (idx_it it = elems[v].begin(); it != elems[v].end(); it++) h += *it;
+					h = (h % n) * (n+1) + adj[v].size();
+					keys.push_back(std::make_pair(h, v));
+				}
+
+				std::sort(keys.begin(), keys.end());
+				for (int a = 0, b; a < (int) keys.size(); a = b) {
+					for (b = a+1; b < (int) keys.size() && keys[b].first == keys[a].first; b++) {}
+					if (b - a == 1) continue;
+
+					for (int x = a; x < b; x++) {
+						int v = keys[x].second;
+						std::sort(adj[v].begin(), adj[v].end());
+						std::sort(elems[v].begin(), elems[v].end());
+					}
+
+					for (int x = a; x < b; x++) {
+						int v = keys[x].second;
+						if (status[v] != amd::LIVE) continue;
+						for (int y = x+1; y < b; y++) {
+							int u = keys[y].second;
+							if (status[u] != amd::LIVE) continue;
+							if (adj[u] != adj[v] || elems[u] != elems[v]) continue;
+
+							parent[u] = v;             /* absorb u into v */
+							nv[v] += nv[u];
+							degree[v] = max(0, degree[v] - nv[u]);
+							nv[u] = 0;
+							status[u] = amd::DEAD;
+							idx_vector_type().swap(adj[u]);
+							idx_vector_type().swap(elems[u]);
+						}
+					}
+				}
+
+				int cnt = 0;
+				owner[p] = INT_MAX;                   /* release the lock on the reach */
+				for (int x = 0; x < (int) Lp.size(); x++) {
+					owner[Lp[x]] = INT_MAX;
+					if (status[Lp[x]] == amd::LIVE) Lp[cnt++] = Lp[x];
+				}
+				Lp.resize(cnt);
+				eliminated += nv[p];
+			}
+		}
+		nel += eliminated;
+
+		/* --- Put the updated variables back in the degree lists ------------ */
+		for (i = 0; i < nw; i++) {
+			idx_vector_type& Lp = lk[winners[i]];
+			for (idx_it it = Lp.begin(); it != Lp.end(); it++) {
+				bucket[degree[*it]].push_back(*it);
+				mindeg = min(mindeg, degree[*it]);
+			}
+		}
+	}
+
+	/* --- Postordering ----------------------------------------------------- */
+	vector<int> head(n+1, -1), next(n+1, -1), stack(n+1), post(n+1);
+	for (int j = n; j >= 0; j--)          /* place unordered nodes in lists */
+	{
+		if (nv[j] > 0) continue;          /* skip if j is an element */
+		next[j] = head[parent[j]];        /* place j in list of its parent */
+		head[parent[j]] = j;
+	}
+	for (int e = n; e >= 0; e--)          /* place elements in lists */
+	{
+		if (nv[e] <= 0) continue;         /* skip unless e is an element */
+		if (parent[e] != -1)
+		{
+			next[e] = head[parent[e]];    /* place e in list of its parent */
+			head[parent[e]] = e;
+		}
+	}
+
+	int k = 0;
+	for (i = 0; i <= n; i++)              /* postorder the assembly tree */
+	{
+		if (parent[i] == -1) k = amd::tdfs(i, k, &head[0], &next[0], &post[0], &stack[0]);
+	}
+
+	std::copy(post.begin(), post.begin() + n, perm.begin());
+}
+
+#endif
@@ -0,0 +1,100 @@
+// -*- mode: c++ -*-
+#ifndef _LILC_MATRIX_SYM_COUNTS_H_
+#define _LILC_MATRIX_SYM_COUNTS_H_
+
+namespace symbolic {
+	/*! \brief Determines whether j is a leaf of the ith row subtree of the elimination tree (see cs_leaf in "Direct Methods for Sparse Linear Systems" by Davis (2006)).
+		\return The lowest common ancestor of j and the previous leaf of the subtree if j is a leaf, -1 otherwise. jleaf is set to 0 if j is not a leaf, 1 if it is the first leaf and 2 if it is a subsequent leaf.
+	*/
+	inline int leaf(int i, int j, const int *first, int *maxfirst, int *prevleaf, int *ancestor, int& jleaf)
+	{
+		int q, s, sparent, jprev;
+		jleaf = 0;
+		if (i <= j || first[j] <= maxfirst[i]) return -1;  /* j not a leaf */
+		maxfirst[i] = first[j];
+		jprev = prevleaf[i];
+		prevleaf[i] = j;
+		jleaf = (jprev == -1) ? 1 : 2;
+		if (jleaf == 1) return i;                        /* q is root of ith subtree */
+		for (q = jprev; q != ancestor[q]; q = ancestor[q]);
+		for (s = jprev; s != q; s = sparent) {           /* path compression */
+			sparent = ancestor[s];
+			ancestor[s] = q;
+		}
+		return q;
+	}
+}
+
+template<class el_type>
+inline void lilc_matrix<el_type> :: sym_counts(idx_vector_type& col_count, idx_vector_type& row_count, int cap) {
+	const int n = m_n_cols;
+	int i, j, k, q, jleaf;
+	idx_vector_type parent(n, -1), ancestor(n, -1);
+
+	//------------- elimination tree (Liu's algorithm on the rows of A) -------------//
+	for (k = 0; k < n; k++) {
+		for (idx_it it = list[k].begin(); it != list[k].end(); it++) {
+			for (i = *it; i != -1 && i < k; i = j) {
+				j = ancestor[i];
+				ancestor[i] = k;             //path compression
+				if (j == -1) parent[i] = k;  //i has no ancestor yet, so k is its parent
+			}
+		}
+	}
+
+	//------------- postorder the elimination tree -------------//
+	idx_vector_type head(n, -1), next(n, -1), post(n), stack(n);
+	for (j = n-1; j >= 0; j--) {
+		if (parent[j] == -1) continue;
+		next[j] = head[parent[j]];
+		head[parent[j]] = j;
+	}
+	for (j = 0, k = 0; j < n; j++) {
+		if (parent[j] == -1) k = amd::tdfs(j, k, &head[0], &next[0], &post[0], &stack[0]);
+	}
+
+	//------------- column counts of the exact factor -------------//
+	//the skeleton matrix algorithm of Gilbert, Ng and Peyton (1994), as in cs_counts.
+	idx_vector_type first(n, -1), maxfirst(n, -1), prevleaf(n, -1);
+	col_count.assign(n, 0);
+
+	for (k = 0; k < n; k++) {
+		j = post[k];
+		col_count[j] = (first[j] == -1) ? 1 : 0;  //j is a leaf of the etree
+		for (; j != -1 && first[j] == -1; j = parent[j]) first[j] = k;
+	}
+
+	for (i = 0; i < n; i++) ancestor[i] = i;
+	for (k = 0; k < n; k++) {
+		j = post[k];
+		if (parent[j] != -1) col_count[parent[j]]--;
+		for (idx_it it = m_idx[j].begin(); it != m_idx[j].end(); it++) {
+			q = symbolic::leaf(*it, j, &first[0], &maxfirst[0], &prevleaf[0], &ancestor[0], jleaf);
+			if (jleaf >= 1) col_count[j]++;
+			if (jleaf == 2) col_count[q]--;
+		}
+		if (parent[j] != -1) ancestor[j] = parent[j];
+	}
+
+	for (j = 0; j < n; j++) {
+		if (parent[j] != -1) col_count[parent[j]] += col_count[j];
+	}
+
+	//------------- row counts, capped at cap -------------//
+	//row i of the factor is the subtree of the etree reached from the non-zeros of
+	//row i of A. the walk stops once cap nodes are found, so this costs O(n*cap).
+	idx_vector_type& mark = first;
+	mark.assign(n, -1);
+	row_count.assign(n, 0);
+	for (i = 0; i < n; i++) {
+		mark[i] = i;
+		for (idx_it it = list[i].begin(); it != list[i].end() && row_count[i] < cap; it++) {
+			for (j = *it; j != -1 && mark[j] != i && row_count[i] < cap; j = parent[j]) {
+				mark[j] = i;
+				row_count[i]++;
+			}
+		}
+	}
+}
+
+#endif
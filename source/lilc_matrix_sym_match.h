@@ -0,0 +1,158 @@
+// -*- mode: c++ -*-
+#ifndef _LILC_MATRIX_SYM_MATCH_H_
+#define _LILC_MATRIX_SYM_MATCH_H_
+
+namespace {
+/*! \brief Functor for comparing nodes by their ratio of diagonal to off-diagonal size (in increasing order).
+	\param v the vector that contains the ratios being compared.
+*/
+template <class el_type>
+struct by_ratio {
+	const vector<el_type>& v;
+	by_ratio(const vector<el_type>& vec) : v(vec) {}
+	bool operator()(int const &a, int const &b) const {
+		return v[a] < v[b];
+	}
+};
+}
+
+namespace symbolic {
+	/*! \brief Tries to pair node k by an augmenting path of length at most 2*depth, as in bipartite matching: a neighbour i of k may be taken from its current mate if that mate can in turn be re-paired.
+		\return True if k was paired.
+	*/
+	inline bool augment(int k, int depth, const vector<int>& ptr, const vector<int>& adj, vector<int>& mate, vector<int>& visited, int stamp)
+	{
+		int p, i;
+		visited[k] = stamp; //k must not be re-paired with itself further down the path
+		for (p = ptr[k]; p < ptr[k+1]; p++) {
+			i = adj[p];
+			if (mate[i] == -1 && i != k && visited[i] != stamp) {
+				mate[k] = i; mate[i] = k;
+				return true;
+			}
+		}
+		if (depth == 0) return false;
+		for (p = ptr[k]; p < ptr[k+1]; p++) {
+			i = adj[p];
+			if (i == k || visited[i] == stamp) continue;
+			visited[i] = stamp;
+			int k2 = mate[i];
+			mate[k2] = -1; mate[i] = -1;
+			if (augment(k2, depth-1, ptr, adj, mate, visited, stamp) && mate[i] == -1) {
+				mate[k] = i; mate[i] = k;
+				return true;
+			}
+			if (mate[k2] != -1) mate[mate[k2]] = -1; //undo a partial re-pairing
+			mate[k2] = i; mate[i] = k2;
+		}
+		return false;
+	}
+}
+
+template<class el_type>
+inline void lilc_matrix<el_type> :: sym_match() {
+	const int n = m_n_cols;
+	const el_type alpha = (1.0+sqrt(17.0))/8.0;
+	int i, j, k;
+
+	//largest off-diagonal element in each row/col of A.
+	elt_vector_type off_max(n, 0), diag(n, 0);
+	for (k = 0; k < n; k++) {
+		for (j = 0; j < (int) m_idx[k].size(); j++) {
+			i = m_idx[k][j];
+			if (i == k) {
+				diag[k] = abs(m_x[k][j]);
+			} else {
+				off_max[k] = std::max(off_max[k], (el_type) abs(m_x[k][j]));
+				off_max[i] = std::max(off_max[i], (el_type) abs(m_x[k][j]));
+			}
+		}
+	}
+
+	//the candidate pairs of every node, largest first. k may only be paired with i
+	//if the 2x2 block is well conditioned (same test as in the static pivoting of ildl()).
+	vector<int> ptr(n+1, 0), adj;
+	vector<el_type> val, ratio(n, 0);
+	vector<int> order;
+	for (k = 0; k < n; k++) {
+		for (j = 0; j < (int) m_idx[k].size() + (int) list[k].size(); j++) {
+			el_type a;
+			if (j < (int) m_idx[k].size()) {
+				i = m_idx[k][j];
+				a = abs(m_x[k][j]);
+			} else {
+				i = list[k][j - m_idx[k].size()];
+				a = abs(coeff(k, i));
+			}
+
+			if (i == k || a == 0 || abs(diag[k]*diag[i] - a*a) <= alpha * a*a) continue;
+			adj.push_back(i);
+			val.push_back(-a);
+		}
+		ptr[k+1] = adj.size();
+
+		//sort the candidates of k by size
+		vector<std::pair<el_type, int> > cand;
+		for (j = ptr[k]; j < ptr[k+1]; j++) cand.push_back(std::make_pair(val[j], adj[j]));
+		std::stable_sort(cand.begin(), cand.end());
+		for (j = ptr[k]; j < ptr[k+1]; j++) adj[j] = cand[j - ptr[k]].second;
+
+		//only nodes that would fail the 1x1 pivot test of Bunch-Kaufman are paired, those
+		//with the smallest diagonal (relative to the rest of their column) first.
+		if (alpha * off_max[k] > diag[k]) {
+			ratio[k] = diag[k]/off_max[k];
+			order.push_back(k);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), by_ratio<el_type>(ratio));
+
+	//greedy pass: pair each node with its largest unpaired candidate.
+	mate.assign(n, -1);
+	for (idx_it ot = order.begin(); ot != order.end(); ot++) {
+		k = *ot;
+		for (j = ptr[k]; j < ptr[k+1] && mate[k] == -1; j++) {
+			if (mate[adj[j]] == -1) {
+				mate[k] = adj[j];
+				mate[adj[j]] = k;
+			}
+		}
+	}
+
+	//augmenting pass: nodes left over may still be paired by re-pairing their neighbours.
+	const int max_depth = 8;
+	vector<int> visited(n, -1);
+	for (idx_it ot = order.begin(); ot != order.end(); ot++) {
+		if (mate[*ot] == -1) symbolic::augment(*ot, max_depth, ptr, adj, mate, visited, *ot);
+	}
+
+	//the 2x2 blocks of static pivoting are built from mate, so it must pair both ways
+	for (k = 0; k < n; k++) {
+		assert(mate[k] == -1 || mate[mate[k]] == k);
+	}
+}
+
+template<class el_type>
+inline void lilc_matrix<el_type> :: pair_perm(vector<int>& perm) {
+	if (mate.empty()) return;
+	const int n = perm.size();
+
+	//walk through perm, placing the mate of each paired node right after it.
+	vector<bool> placed(n, false);
+	vector<int> new_perm;
+	new_perm.reserve(n);
+	for (int i = 0; i < n; i++) {
+		int k = perm[i];
+		if (placed[k]) continue;
+		new_perm.push_back(k);
+		placed[k] = true;
+
+		if (mate[k] != -1 && !placed[mate[k]]) {
+			new_perm.push_back(mate[k]);
+			placed[mate[k]] = true;
+		}
+	}
+
+	perm.swap(new_perm);
+}
+
+#endif
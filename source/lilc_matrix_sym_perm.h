@@ -41,6 +41,14 @@ void lilc_matrix<el_type> :: sym_perm(std::vector<int>& perm) {
 	m_idx.swap(m_idx_new);
 	m_x.swap(m_x_new);
 	
+	if (!mate.empty()) {
+		vector<int> mate_new(m_n_cols);
+		for (i = 0; i < m_n_cols; i++) {
+			mate_new[pinv[i]] = (mate[i] == -1 ? -1 : pinv[mate[i]]);
+		}
+		mate.swap(mate_new);
+	}
+	
 	for (i = 0; i < m_n_cols; i++) {
 		ensure_invariant(i, i, m_idx[i]);
 		ensure_invariant(i, i, list[i], true);
@@ -4,21 +4,14 @@
 
 namespace {
 /*! \brief Functor for comparing elements by degree (in increasing order) instead of by index.
-	\param A a pointer to the matrix being reordered.
+	\param deg the precomputed degree of every node.
 */
-template <class el_type>
 struct by_degree {
-	lilc_matrix<el_type>* A;
-	by_degree(lilc_matrix<el_type>* mat) : A(mat) {}
+	const vector<int>& deg;
+	by_degree(const vector<int>& d) : deg(d) {}
 	bool operator()(int const &a, int const &b) const { 
-		int deg_a = A->list[a].size() + A->m_idx[a].size();
-		int deg_b = A->list[b].size() + A->m_idx[b].size();
-		
-		if (A->m_idx[a].size() > 0 && A->m_idx[a][0] == a) deg_a--;
-		if (A->m_idx[b].size() > 0 && A->m_idx[b][0] == b) deg_b--;
-		
-		if (deg_a == deg_b) return a > b;
-		return deg_a < deg_b;
+		if (deg[a] == deg[b]) return a > b;
+		return deg[a] < deg[b];
 	}
 };
 }
@@ -26,23 +19,35 @@ struct by_degree {
 template<class el_type> 
 inline void lilc_matrix<el_type> :: sym_rcm(vector<int>& perm) {
 	int i, s;
-	vector<bool> visited(m_n_cols, false);
-	vector<int> lvl_set;
-	for (i = 0; i < m_n_cols; i++) {
-		if (visited[i]) continue;
-		
-		lvl_set.clear();
+	const int ncols = m_n_cols;
+
+	bfs_struct b;
+	b.resize(ncols);
+
+	//degrees are computed once here instead of on every comparison
+	long long total_edges = 0;
+	#pragma omp parallel for reduction(+:total_edges)
+	for (i = 0; i < ncols; i++) {
+		int deg = list[i].size() + m_idx[i].size();
+		if (m_idx[i].size() > 0 && m_idx[i][0] == i) deg--;
+		b.deg[i] = deg;
+		total_edges += deg;
+	}
+	b.unvisited_edges = total_edges;
+
+	by_degree sorter(b.deg);
+	perm.reserve(perm.size() + ncols);
+	for (i = 0; i < ncols; i++) {
+		if (bfs_struct::test(b.visited, i)) continue;
+
 		s = i;
-		find_root(s);
-		lvl_set.push_back(s);
+		find_root(s, b);
+		b.start(s);
 		perm.push_back(s);
 		
-		by_degree<el_type> sorter(this);
-		
-		visited[s] = true;
-		while (find_level_set(lvl_set, visited)) {
-			sort(lvl_set.begin(), lvl_set.end(), sorter);
-			perm.insert( perm.end(), lvl_set.begin(), lvl_set.end() );	
+		while (find_level_set(b)) {
+			sort(b.lvl_set.begin(), b.lvl_set.end(), sorter);
+			perm.insert( perm.end(), b.lvl_set.begin(), b.lvl_set.end() );
 		}
 	}
 	
@@ -0,0 +1,109 @@
+// -*- mode: c++ -*-
+#ifndef _MTX_TEXT_H_
+#define _MTX_TEXT_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//the text of a matrix is formatted in chunks of about this many entries
+static const int mtx_chunk_entries = 1 << 16;
+
+/*! \brief Writes the decimal digits of i at p.
+	\return The end of the text written.
+*/
+inline char* mtx_put(char* p, long long i) {
+	unsigned long long u = i;
+	if (i < 0) {
+		*p++ = '-';
+		u = 0 - u;
+	}
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	while (n) *p++ = digits[--n];
+	return p;
+}
+
+inline char* mtx_put(char* p, int i) {
+	return mtx_put(p, (long long) i);
+}
+
+/*! \brief Writes the shortest text that reads back as exactly x at p (at most 32 characters).
+
+	Without std::to_chars (before C++17), the text has 17 significant digits instead, which always read back as x but are not the shortest.
+	\return The end of the text written.
+*/
+inline char* mtx_put(char* p, double x) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+	return std::to_chars(p, p + 32, x).ptr;
+#else
+	return p + snprintf(p, 32, "%.17g", x);
+#endif
+}
+
+inline char* mtx_put(char* p, float x) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+	return std::to_chars(p, p + 32, x).ptr;
+#else
+	return p + snprintf(p, 32, "%.9g", x);
+#endif
+}
+
+/*! \brief Appends the line "i j x" of a Matrix Market coordinate file to buf.
+*/
+template<class el_type>
+inline void mtx_put_entry(std::string& buf, int i, int j, el_type x) {
+	char line[96];
+	char* p = mtx_put(line, i);
+	*p++ = ' ';
+	p = mtx_put(p, j);
+	*p++ = ' ';
+	p = mtx_put(p, x);
+	*p++ = '\n';
+	buf.append(line, p - line);
+}
+
+/*! \brief Writes a text formatted in chunks to out.
+
+	The chunks are formatted a round at a time, one chunk per thread, each into a buffer of its own. The buffers are then written in order with one write each, so the memory used is that of one round of chunks.
+
+	\param out the stream written to.
+	\param n_chunks the number of chunks.
+	\param format a function that appends the text of chunk c to buf, i.e. format(c, buf). It is called for different chunks concurrently.
+	\param parallel if false, all chunks are formatted on the calling thread.
+	\return True if all of the text was written.
+*/
+template<class format_fn>
+bool mtx_write_chunks(std::ostream& out, int n_chunks, format_fn format, bool parallel = true) {
+	int threads = 1;
+#ifdef _OPENMP
+	if (parallel) threads = omp_get_max_threads();
+#endif
+	std::vector<std::string> bufs(threads);
+	for (int start = 0; start < n_chunks && out; start += threads) {
+		const int end = std::min(n_chunks, start + threads);
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(threads) if (threads > 1 && end - start > 1)
+		for (int c = start; c < end; c++) {
+			bufs[c - start].clear();
+			format(c, bufs[c - start]);
+		}
+		for (int c = start; c < end; c++) {
+			out.write(bufs[c - start].data(), bufs[c - start].size());
+		}
+	}
+	return (bool) out;
+}
+
+#endif
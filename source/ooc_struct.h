@@ -0,0 +1,172 @@
+// -*- mode: c++ -*-
+#ifndef _OOC_STRUCT_H_
+#define _OOC_STRUCT_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <cstdio>
+#include <algorithm>
+
+/*! \brief The on-disk storage of the columns of an out-of-core factor.
+
+	Columns are appended to a binary file as they are evicted, each as its values followed by its indices (padded to a multiple of 8 bytes). Once the factorization is finished, reorder() rewrites the file in column order. During the solves, columns are read back through a buffer that holds a large chunk of the file, so that the triangular sweeps stream through it instead of reading every column separately.
+*/
+template<class el_type>
+class ooc_struct
+{
+	public:
+		std::string filename;	///<The file the columns are evicted to. It is removed when this struct is destroyed.
+		std::fstream file;	///<The file, opened for both writing (during the factorization) and reading (during the solves).
+		std::vector<long long> offset;	///<The position of each column in the file, or -1 if it is still in memory.
+		std::vector<int> len;	///<The length of each evicted column.
+		std::vector<char> state;	///<0 if a column is still being formed, 1 if it is finished but still in memory, and 2 if it has been evicted.
+		std::deque<int> finished;	///<The finished columns still in memory, in the order they were finished.
+		long long file_end;	///<The size of the file.
+		size_t window;	///<The number of bytes of finished columns kept in memory.
+		size_t resident;	///<The number of bytes of finished columns currently in memory.
+		size_t freed;	///<The number of bytes of memory released by evicting columns.
+		int num_evicted;	///<The number of columns evicted.
+
+		std::vector<char> buf;	///<The read buffer used by the solves.
+		long long buf_start;	///<The position in the file of the first byte of the read buffer.
+		long long buf_end;	///<The position in the file of the byte after the last byte of the read buffer.
+		std::mutex lock;	///<Serializes the solves, which share the read buffer.
+
+		/*! \brief Creates (or truncates) the file the columns of an n*n factor are evicted to.
+			\param name the filename.
+			\param n the number of columns.
+			\param window_bytes the number of bytes of finished columns kept in memory.
+		*/
+		ooc_struct(const std::string& name, int n, size_t window_bytes) : filename(name), offset(n, -1), len(n, 0), state(n, 0), file_end(0), window(window_bytes), resident(0), freed(0), num_evicted(0), buf_start(0), buf_end(0) {
+			file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		}
+
+		~ooc_struct() {
+			file.close();
+			std::remove(filename.c_str());
+		}
+
+		/*! \return The number of bytes a column of length l takes in the file. */
+		static long long col_bytes(int l) {
+			long long b = (long long) l*(sizeof(el_type) + sizeof(int));
+			return (b + 7)/8*8;
+		}
+
+		/*! \brief Marks column j as finished, i.e. it will not be changed or read again during the factorization. The oldest finished columns are then evicted until those still in memory fit in the window.
+			\param j the column.
+			\param idx the indices of all columns.
+			\param x the values of all columns.
+		*/
+		void retire(int j, std::vector< std::vector<int> >& idx, std::vector< std::vector<el_type> >& x) {
+			if (state[j] != 0) return;
+			state[j] = 1;
+			finished.push_back(j);
+			resident += idx[j].capacity()*sizeof(int) + x[j].capacity()*sizeof(el_type);
+			
+			while (resident > window && !finished.empty()) {
+				int i = finished.front();
+				finished.pop_front();
+				size_t b = idx[i].capacity()*sizeof(int) + x[i].capacity()*sizeof(el_type);
+				resident -= b;
+				if (evict(i, idx[i], x[i])) freed += b;
+			}
+		}
+
+		/*! \brief Appends column j to the file and releases its memory. If the write fails (e.g. the disk is full), the column stays in memory.
+			\param j the column.
+			\param idx the indices of the column.
+			\param x the values of the column.
+			\return True if the column was evicted.
+		*/
+		bool evict(int j, std::vector<int>& idx, std::vector<el_type>& x) {
+			const int l = idx.size();
+			const long long b = col_bytes(l);
+			file.seekp(file_end);
+			file.write((const char*) x.data(), l*sizeof(el_type));
+			file.write((const char*) idx.data(), l*sizeof(int));
+			static const char pad[8] = {0};
+			file.write(pad, b - (long long) l*(sizeof(el_type) + sizeof(int)));
+			if (!file) {
+				file.clear();
+				return false;
+			}
+
+			offset[j] = file_end;
+			len[j] = l;
+			file_end += b;
+			state[j] = 2;
+			num_evicted++;
+
+			std::vector<int>().swap(idx);
+			std::vector<el_type>().swap(x);
+			return true;
+		}
+
+		/*! \brief Rewrites the file with the evicted columns in column order. Columns are evicted in the order they are finished, which is far from column order, while the triangular solves go through the columns from first to last (or last to first). In column order, they stream through the file a buffer at a time instead of refilling the buffer for almost every column. Called once, when the factorization is finished.
+			\return True if the file was rewritten. Otherwise it is left as it was (and can still be read, only more slowly).
+		*/
+		bool reorder() {
+			const std::string tmp = filename + ".sorted";
+			std::ofstream out(tmp.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+			if (!out) return false;
+
+			std::vector<long long> new_offset(offset.size(), -1);
+			std::vector<char> col;
+			long long pos = 0;
+			file.clear();
+			for (int j = 0; j < (int) offset.size() && file && out; j++) {
+				if (state[j] != 2) continue;
+				const long long b = col_bytes(len[j]);
+				col.resize(b);
+				file.seekg(offset[j]);
+				file.read(col.data(), b);
+				out.write(col.data(), b);
+				new_offset[j] = pos;
+				pos += b;
+			}
+			out.close();
+			if (!file || out.fail()) {
+				file.clear();
+				std::remove(tmp.c_str());
+				return false;
+			}
+
+			file.close();
+			if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+				//rename does not replace an existing file on every platform
+				std::remove(filename.c_str());
+				std::rename(tmp.c_str(), filename.c_str());
+			}
+			file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+			offset.swap(new_offset);
+			file_end = pos;
+			buf_start = buf_end = 0;
+			return true;
+		}
+
+		/*! \brief Reads column j back from the file (through the read buffer).
+			\param j the column (which must have been evicted).
+			\param idx set to the indices of the column, which are valid until the next call.
+			\param x set to the values of the column, which are valid until the next call.
+			\param backwards if true, the buffer is filled with the part of the file before column j rather than after it, for sweeps that go from the last column to the first.
+		*/
+		void fetch(int j, const int*& idx, const el_type*& x, bool backwards) {
+			const long long start = offset[j], end = start + col_bytes(len[j]);
+			if (start < buf_start || end > buf_end) {
+				const long long chunk = std::max((long long) (1 << 22), end - start);
+				buf_start = (backwards ? std::max(0LL, end - chunk) : start);
+				buf_end = std::min(file_end, buf_start + chunk);
+				buf.resize(buf_end - buf_start);
+				file.clear();
+				file.seekg(buf_start);
+				file.read(buf.data(), buf_end - buf_start);
+			}
+			x = (const el_type*) (buf.data() + (start - buf_start));
+			idx = (const int*) (buf.data() + (start - buf_start) + len[j]*sizeof(el_type));
+		}
+};
+
+#endif
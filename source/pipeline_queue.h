@@ -0,0 +1,59 @@
+// -*- mode: c++ -*-
+#ifndef _PIPELINE_QUEUE_H_
+#define _PIPELINE_QUEUE_H_
+
+/*!	\brief A bounded queue handing work from one stage of a pipeline to the next, e.g. loaded matrices to the factorization, and factored matrices to the saving of the factors.
+
+	push() blocks while the queue is full, so a fast stage can only run a fixed number of items ahead of a slow one, which caps the memory held by the pipeline. pop() blocks until an item arrives or the queue is closed by the producing stage.
+*/
+template<class T>
+class pipeline_queue
+{
+	public:
+		/*!	\brief Creates an empty queue.
+			\param capacity the number of items the queue holds before push() blocks (at least 1).
+		*/
+		explicit pipeline_queue(int capacity = 1) : m_capacity(capacity < 1 ? 1 : capacity), m_closed(false) {}
+
+		/*!	\brief Appends an item, waiting for room if the queue is full.
+			\param item the item, which is moved into the queue.
+		*/
+		void push(T&& item) {
+			std::unique_lock<std::mutex> guard(m_lock);
+			m_not_full.wait(guard, [this] { return (int) m_items.size() < m_capacity; });
+			m_items.push_back(std::move(item));
+			m_not_empty.notify_one();
+		}
+
+		/*!	\brief Removes the oldest item, waiting for one if the queue is empty.
+			\param item set to the item removed.
+			\return False if the queue is empty and has been closed, i.e. there are no more items.
+		*/
+		bool pop(T& item) {
+			std::unique_lock<std::mutex> guard(m_lock);
+			m_not_empty.wait(guard, [this] { return !m_items.empty() || m_closed; });
+			if (m_items.empty()) return false;
+			item = std::move(m_items.front());
+			m_items.pop_front();
+			m_not_full.notify_one();
+			return true;
+		}
+
+		/*!	\brief Marks the end of the items. Items already in the queue can still be popped.
+		*/
+		void close() {
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_closed = true;
+			m_not_empty.notify_all();
+		}
+
+	private:
+		std::deque<T> m_items;	///<The items in the queue, oldest first.
+		int m_capacity;	///<The number of items the queue holds before push() blocks.
+		bool m_closed;	///<True once close() has been called.
+		std::mutex m_lock;	///<Guards all of the above.
+		std::condition_variable m_not_full;	///<Signalled when an item is popped.
+		std::condition_variable m_not_empty;	///<Signalled when an item is pushed or the queue is closed.
+};
+
+#endif
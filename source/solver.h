@@ -3,20 +3,31 @@
 
 #include <iostream>
 #include <cstring>
-#include <ctime>
+#include <chrono>
 #include <iomanip>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "lilc_matrix.h"
 
 namespace symildl {
 
+#include "solver_workspace.h"
+#include "csc_view.h"
+#include "csr_matrix.h"
+#include "pipeline_queue.h"
+
 // Using struct'd enums to achieve a C++11 style enum class without C++11
 struct reordering_type {
 	enum {
 		NONE,
 		AMD,
 		RCM,
-		MC64
+		MC64,
+		PAR_AMD
 	};
 };
 
@@ -34,7 +45,9 @@ struct solver_type {
 		NONE,
 		MINRES,
 		SQMR,
-		FULL
+		FULL,
+		GMRES,
+		FGMRES
 	};
 };
 
@@ -57,19 +70,20 @@ bool save_vector(const std::vector<el_type>& vec, std::string filename) {
 	if(!out)
 	return false;
 
-	out.flags(std::ios_base::scientific);
-	out.precision(12);
 	std::string header = "%%MatrixMarket matrix coordinate real general";; 
 
-	out << header << std::endl; 
+	out << header << "\n"; 
 	out << vec.size() << " " << 1 << " " << vec.size() << "\n";
 
-	for(int i = 0; i < (int) vec.size(); i++) {
-		out << i+1 << " " << 1 << " " << vec[i] << "\n";
-	}
+	const int n = vec.size();
+	bool ok = mtx_write_chunks(out, (n + mtx_chunk_entries - 1)/mtx_chunk_entries, [&](int c, std::string& buf) {
+		for (int i = c*mtx_chunk_entries; i < std::min(n, (c+1)*mtx_chunk_entries); i++) {
+			mtx_put_entry(buf, i+1, 1, vec[i]);
+		}
+	});
 	
 	out.close();
-	return true;
+	return ok && !out.fail();
 }
 
 /*!	\brief Reads in a dense row or column vector vec in matrix market (.mtx) format.
@@ -117,9 +131,24 @@ bool read_vector(std::vector<el_type>& vec, std::string filename, int msg_lvl =
 	return true;
 }
 
+/*! \return The wall clock time in seconds since start. Unlike clock(), this does not add up the time of every thread.
+*/
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*! \return A new id for a factorization, unique among all factorizations (of any solver) in the process.
+*/
+inline long long next_factor_id() {
+	static std::atomic<long long> last(0);
+	return ++last;
+}
+
 /*! \brief Set of tools that facilitates conversion between different matrix formats. Also contains solver methods for matrices using a common interface.
 
 	Currently, the only matrix type accepted is the lilc_matrix (as no other matrix type has been created yet).
+	
+	Once factor() has been called, the factorization (A, L, D, S and perm) is only read by the solve methods, which are all const. A single solver can therefore be shared by many threads, each solving with its own solver_workspace.
 */
 template<class el_type, class mat_type = lilc_matrix<el_type> >
 class solver {
@@ -127,18 +156,39 @@ class solver {
         typedef typename mat_type::pivot_type pivot_type;
         
 		mat_type A;	///<The matrix to be factored.
+		csc_view<el_type> A_view;	///<If not empty, the caller's CSC arrays of A (see load_view()). A is then only built from them for the factorization.
+		csr_matrix<el_type> A_csr;	///<If not empty, a CSR copy of the permuted and equilibrated A that the solves multiply with (see set_csr_spmv()).
 		mat_type L;	///<The lower triangular factor of A.
 		
         vector<int> perm;	///<A permutation vector containing all permutations on A.
+		vector<int> iperm;	///<The inverse of perm, i.e. iperm[perm[i]] = i.
 		block_diag_matrix<el_type> D;	///<The diagonal factor of A.
+		
+		lilc_matrix<float> Lf;	///<The lower triangular factor of A, in single precision (mixed precision full solves only).
+		block_diag_matrix<float> Df;	///<The diagonal factor of A, in single precision (mixed precision full solves only).
+		vector<int> piv_perm;	///<The permutation done by pivoting during the single precision factorization (A itself is not factored).
+		double norm_A;	///<The inf-norm of the permuted and equilibrated A (mixed precision full solves only).
+		bool mixed_precision; ///<Set to true to do full solves with a single precision factorization and iterative refinement in double precision.
 		int reorder_type; ///<Set to to 0 for AMD, 1 for RCM, 2 for no reordering.
         int piv_type; ///<Set to 0 for rook, 1 for bunch.
+		int max_refine; ///<The maximum number of steps of iterative refinement done after a full solve. Set to -1 to refine only when static pivoting is used.
+		int shift_tries; ///<The maximum number of times the factorization is redone with a larger diagonal shift after a breakdown (0 to never shift).
+		double shift_init; ///<The first diagonal shift tried after a breakdown. Every retry multiplies it by 10.
+		double max_growth; ///<The factorization is deemed to have broken down if an entry of L is larger than this (see lilc_matrix::pivot_growth), or if a pivot had to be perturbed.
+		double diag_shift; ///<The diagonal shift alpha with which A + alpha*I was factored in the last call to factor().
+		size_t mem_budget; ///<If > 0, the storage of the factors is kept within this many bytes (see lilc_matrix::mem_budget).
+		std::string ooc_file; ///<If not empty, L is kept out of core in this file (see lilc_matrix::ooc_file).
+		size_t ooc_window; ///<The number of bytes of finished columns of L kept in memory by an out-of-core factorization.
+		std::string checkpoint_file; ///<If not empty, the factorization is checkpointed to this file (see lilc_matrix::checkpoint_file).
+		double checkpoint_interval; ///<The number of seconds between two checkpoints of the factorization.
+		int max_neg; ///<If >= 0, the factorization stops as soon as it has more than max_neg negative pivots (see lilc_matrix::max_neg_pivots).
 		
         int equil_type; ///<The equilibration method used. Set to 1 for max-norm equilibriation.
 		
 	int msg_lvl; ///<Controls the amount of output to stdout.
 		int solve_type; //<The type of solver used to solve the right hand side.
 		bool has_rhs; ///<Set to true if we have a right hand side that we expect to solve.
+		bool has_guess; ///<Set to true if sol_vec holds an initial guess for the iterative solver.
 		bool perform_inplace; ///<Set to true if we are factoring the matrix A inplace.
        		// TODO: refactor this away
 		bool save_sol; ///<Set to true if we want to save the solution to a file.
@@ -146,6 +196,19 @@ class solver {
         vector<el_type> rhs; ///<The right hand side we'll solve for.
 		vector<el_type> sol_vec; ///<The solution vector.
 		
+		int max_iters; ///<The maximum number of iterations of the iterative solver.
+		double solver_tol; ///<The stopping tolerance of the iterative solver.
+		double minres_shift; ///<The shift used by MINRES.
+		bool pipelined; ///<Set to true to use the pipelined variants of SQMR and MINRES.
+		bool csr_spmv; ///<Set to true to multiply with a CSR copy of A in the solves, instead of with A itself.
+		int check_every; ///<SQMR checks for convergence only every check_every iterations.
+		int recycle_dim; ///<The dimension of the subspace recycled by MINRES between solves (0 to turn recycling off).
+		long long factor_id; ///<Identifies the current factorization (unique among all solvers in the process), so that workspaces can tell when their recycled subspace is stale.
+		int gmres_restart; ///<The restart length m of GMRES(m) and FGMRES(m).
+		bool gmres_reorth; ///<Set to true to reorthogonalise the krylov basis of GMRES and FGMRES.
+		std::function<void(const vector<el_type>&, vector<el_type>&)> precond; ///<If set, replaces the LDL' preconditioner in FGMRES.
+		solver_workspace<el_type> work; ///<The workspace used by solve(b, x).
+		
 		/*! \brief Solver constructor, initializes default reordering scheme.
 		*/
 		solver() {
@@ -154,7 +217,26 @@ class solver {
 			reorder_type = reordering_type::AMD;
 			equil_type = equilibration_type::BUNCH;
 			solve_type = solver_type::SQMR;
+			max_refine = -1;
+			max_neg = -1;
+			mem_budget = 0;
+			ooc_window = 0;
+			checkpoint_interval = 600;
+			shift_tries = 0;
+			shift_init = 1e-3;
+			max_growth = 1e6;
+			diag_shift = 0;
+			mixed_precision = false;
+			set_solver_params();
+			pipelined = false;
+			csr_spmv = false;
+			check_every = 1;
+			recycle_dim = 0;
+			gmres_restart = 30;
+			gmres_reorth = false;
+			factor_id = 0;
             		has_rhs = false;
+            		has_guess = false;
             		perform_inplace = false;
 		}
 				
@@ -162,6 +244,7 @@ class solver {
 			\param filename the filename of the matrix.
 		*/
 		void load(std::string filename) {
+			A_csr.clear();
 			bool result = A.load(filename);
 			assert(result);
 			if (msg_lvl) printf("A is %d by %d with %d non-zeros.\n", A.n_rows(), A.n_cols(), A.nnz() );
@@ -170,6 +253,7 @@ class solver {
 		/*! \brief Loads the matrix A into solver. A must be of CSC format.
 		*/
 		void load(const std::vector<int>& ptr, const std::vector<int>& row, const std::vector<el_type>& val) {
+			A_csr.clear();
 			bool result = A.load(ptr, row, val);
 			assert(result);	
 			if (msg_lvl) printf("A is %d by %d with %d non-zeros.\n", A.n_rows(), A.n_cols(), A.nnz() );
@@ -178,11 +262,23 @@ class solver {
 		/*! \brief Loads the matrix A into solver. A must be of CSC format.
 		*/
 		void load(const int* ptr, const int* row, const el_type* val, int dim) {
+			A_csr.clear();
 			bool result = A.load(ptr, row, val, dim);
 			assert(result);	
 			if (msg_lvl) printf("A is %d by %d with %d non-zeros.\n", A.n_rows(), A.n_cols(), A.nnz() );
 		}
 
+		/*! \brief Loads a read-only view of the matrix A in CSC format, without copying it. The arrays must stay alive and unchanged as long as the solver is used (only the lower triangle of A is read).
+			
+			The LIL-C copy of A that the factorization modifies is only built by factor(), and is released again once A is factored. The iterative solvers and refinement then multiply with the arrays directly, so a factored solver holds no copy of A. The permuted and equilibrated A (outB.mtx) is then only saved by save() if a CSR copy of it is kept (see set_csr_spmv()).
+		*/
+		void load_view(const int* ptr, const int* row, const el_type* val, int dim) {
+			A_csr.clear();
+			A_view = csc_view<el_type>(ptr, row, val, dim);
+			A.resize(dim, dim);
+			if (msg_lvl) printf("A is %d by %d with %d stored non-zeros (viewed in place).\n", dim, dim, A_view.stored() );
+		}
+
 		
 		/*! \brief Loads a right hand side b into the solver.
 			\param b a vector of the right hand side.
@@ -193,6 +289,14 @@ class solver {
 			if (msg_lvl) printf("Right hand side has %d entries.\n", rhs.size() );
 		}
 		
+		/*! \brief Loads an initial guess x0 for the iterative solver into the solver.
+			\param x0 a vector of the initial guess.
+		*/
+		void set_initial_guess(vector<el_type> x0) {
+			sol_vec = x0;
+			has_guess = true;
+		}
+		
 		/*! \brief Sets the reordering scheme for the solver.
 		*/
 		void set_reorder_scheme(const char* ordering) {
@@ -200,6 +304,8 @@ class solver {
 				reorder_type = reordering_type::RCM;
 			} else if (strcmp(ordering, "amd") == 0) {
 				reorder_type = reordering_type::AMD;
+			} else if (strcmp(ordering, "par_amd") == 0) {
+				reorder_type = reordering_type::PAR_AMD;
 			} else if (strcmp(ordering, "none") == 0) {
 				reorder_type = reordering_type::NONE;
 			}
@@ -224,6 +330,10 @@ class solver {
 				solve_type = solver_type::SQMR;
 			} else if (strcmp(solver, "full") == 0) {
 				solve_type = solver_type::FULL;
+			} else if (strcmp(solver, "gmres") == 0) {
+				solve_type = solver_type::GMRES;
+			} else if (strcmp(solver, "fgmres") == 0) {
+				solve_type = solver_type::FGMRES;
 			} else if (strcmp(solver, "none") == 0) {
 				solve_type = solver_type::NONE;
 			}
@@ -254,40 +364,185 @@ class solver {
                 piv_type = pivot_type::ROOK;
             } else if (strcmp(pivot, "bunch") == 0) {
                 piv_type = pivot_type::BKP;
+            } else if (strcmp(pivot, "static") == 0) {
+                piv_type = pivot_type::STATIC;
             }
 		}
 
+		/*! \brief Sets the parameters of the iterative solvers used by solve(b, x).
+			\param max_iter the maximum number of iterations.
+			\param stop_tol the stopping tolerance. i.e. we stop as soon as the relative residual goes below stop_tol.
+			\param shift shifts A by shift*(identity matrix) in MINRES.
+		*/
+		void set_solver_params(int max_iter = 1000, double stop_tol = 1e-6, double shift = 0.0) {
+			max_iters = max_iter;
+			solver_tol = stop_tol;
+			minres_shift = shift;
+		}
+		
+		/*! \brief Decides whether the pipelined variants of SQMR and MINRES are used. These need only one (fused) reduction per iteration, at the cost of a few extra vectors and slightly less stable recurrences. The reduction is not overlapped with the products, so this only saves synchronisation points.
+		*/
+		void set_pipelined(bool pipe) {
+			pipelined = pipe;
+		}
+		
+		/*! \brief Decides whether factor() converts the permuted and equilibrated A into a CSR copy (with both halves stored), which the iterative solvers and refinement then multiply with. Its product is threaded and vectorised, and the LIL-C storage of A is released, so factor() refuses to factor A again until it is loaded again (unless it was loaded with load_view()).
+		*/
+		void set_csr_spmv(bool csr) {
+			csr_spmv = csr;
+		}
+		
+		/*! \brief Makes SQMR check for convergence (and save its best iterate) only every m iterations, saving a reduction in each of the others.
+		*/
+		void set_convergence_check(int m) {
+			check_every = std::max(m, 1);
+		}
+		
+		/*! \brief Sets the parameters of GMRES(m) and FGMRES(m).
+			\param restart the number of iterations m after which GMRES restarts (and the size of its krylov basis).
+			\param reorth if true, every new basis vector is orthogonalised twice, which keeps the basis orthogonal to working precision.
+		*/
+		void set_gmres(int restart, bool reorth = false) {
+			gmres_restart = std::max(restart, 1);
+			gmres_reorth = reorth;
+		}
+		
+		/*! \brief Sets the preconditioner used by FGMRES, which may change from one iteration to the next (e.g. an inexact triangular solve). By default, FGMRES uses the LDL' factors, like the other solvers.
+			\param prec a function computing out = M^(-1)*in for the permuted and equilibrated matrix.
+		*/
+		void set_preconditioner(std::function<void(const vector<el_type>&, vector<el_type>&)> prec) {
+			precond = prec;
+		}
+		
+		/*! \brief Makes MINRES recycle a subspace of dimension k between solves. 
+			
+			The subspace holds approximate eigenvectors of the preconditioned matrix for the eigenvalues closest to 0, which are deflated from later solves with the same workspace. This helps most for sequences of right hand sides with the same matrix, where these modes otherwise cost many iterations in every solve. When the matrix is refactored, the subspace no longer belongs to the preconditioned matrix, and is discarded by the next solve. Recycling always uses the standard (not pipelined) MINRES.
+		*/
+		void set_recycling(int k) {
+			recycle_dim = std::max(k, 0);
+		}
+		
+		/*! \brief Makes factor() retry a factorization that broke down (too much pivot growth, perturbed pivots, or more negative pivots than allowed by set_inertia_limit()) on A + alpha*I, for alpha = shift, 10*shift, ... The equilibrated and permuted A is kept for this, so nothing but the factorization is redone. The solvers still solve with A, using the factors of the shifted matrix as a preconditioner. The shift chosen is stored in diag_shift.
+			
+			Not used with inplace or mixed precision factorizations.
+			
+			\param tries the maximum number of refactorizations (0 to turn this off).
+			\param shift the first shift tried (A is equilibrated, so that its entries are at most 1 in magnitude).
+			\param growth the largest entry of L allowed.
+		*/
+		void set_adaptive_shift(int tries, double shift = 1e-3, double growth = 1e6) {
+			shift_tries = tries;
+			shift_init = shift;
+			max_growth = growth;
+		}
+		
+		/*! \brief Limits the storage used by the factorization (L, D, and the work vectors of ildl(), but not A) to a number of bytes. The factorization keeps track of its storage as it goes, and lowers the fill allowed in the remaining columns (raising the drop tolerance with it) to stay within the budget. The storage used is reported after factor().
+			
+			Not used by inplace factorizations.
+			
+			\param bytes the budget in bytes, or 0 for no budget.
+		*/
+		void set_memory_budget(size_t bytes) {
+			mem_budget = bytes;
+		}
+		
+		/*! \brief Keeps L out of core: as the factorization finishes with each column of L, the column is evicted to a file, keeping only a window of the most recently finished columns in memory. The solves then stream L back in from the file, so that the preconditioner can be larger than memory. The file is removed when the factors are.
+			
+			Not used by inplace factorizations. Sparse solves and selected inversion need L in memory, and are not available.
+			
+			\param filename the file L is evicted to, or an empty string to keep L in memory.
+			\param window_bytes the number of bytes of finished columns of L kept in memory.
+		*/
+		void set_out_of_core(const std::string& filename, size_t window_bytes = 0) {
+			ooc_file = filename;
+			ooc_window = window_bytes;
+		}
+		
+		/*! \brief Makes the factorization save its state to a file every so often, so that a job that is killed part way through (e.g. preempted by a batch scheduler) can be run again and pick up from the last checkpoint rather than from the start. A checkpoint is only resumed from if it is of the same matrix, factored with the same parameters, and is removed once the factorization is done.
+			
+			Not used by inplace or out-of-core factorizations.
+			
+			\param filename the checkpoint file, or an empty string for no checkpoints.
+			\param interval the number of seconds between two checkpoints.
+		*/
+		void set_checkpoint(const std::string& filename, double interval = 600) {
+			checkpoint_file = filename;
+			checkpoint_interval = interval;
+		}
+		
+		/*! \brief Makes factor() stop as soon as the factorization has more than k negative pivots, e.g. when an interior point method will regularise and refactor a KKT matrix with the wrong inertia anyway. The stopped factorization cannot be solved with (see stopped_early()).
+			\param k the largest number of negative pivots allowed, or -1 for no limit.
+		*/
+		void set_inertia_limit(int k) {
+			max_neg = k;
+		}
+		
+		/*! \brief Decides whether full solves use a single precision factorization (half the memory and bandwidth of the factors) refined to double precision accuracy by iterative refinement, with residuals computed in double precision against A. Only used with the full solver.
+		*/
+		void set_mixed_precision(bool mixed) {
+			mixed_precision = mixed;
+		}
+		
+		/*! \brief Sets the maximum number of steps of iterative refinement done after a full solve. If negative, 3 steps are done with static pivoting and none otherwise.
+		*/
+		void set_refinement(int steps) {
+			max_refine = steps;
+		}
+
 		/*! \brief Factors the matrix A into P' * S * A * S * P = LDL' in addition to printing some timing data to screen.
 			
-			More information about the parameters can be found in the documentation for the ildl() function.
+			More information about the parameters can be found in the documentation for the ildl() function. After this, any number of right hand sides can be solved for with solve(b, x).
 			
 			\param fill_factor a factor controling memory usage of factorization.
 			\param tol a factor controling accuracy of factorization.
 			\param pp_tol a factor controling the aggresiveness of Bunch-Kaufman pivoting.
-			\param max_iter the maximum number of iterations for minres (ignored if no right hand side).
+			\param fws an optional workspace for the temporary vectors of the factorization, to be reused by later calls (see factor_batch()). Not used by mixed precision factorizations.
 		*/
-		void solve(double fill_factor, double tol, double pp_tol, int max_iter = -1, double minres_tol = 1e-6, double shift = 0.0) {
+		void factor(double fill_factor, double tol, double pp_tol, ildl_workspace<el_type>* fws = NULL) {
             // A full factorization is equivalent to a fill factor of n and tol of 0
             if (solve_type == solver_type::FULL) {
                 tol = 0.0;
                 fill_factor = A.n_cols();
             }
             
+			// the CSR copy replaced the LIL-C storage of A (see set_csr_spmv()), so
+			// unless A is viewed, there is nothing left to factor
+			if (!A_csr.empty() && A_view.empty()) {
+				if (msg_lvl) printf("A was released when it was copied to CSR, so it cannot be factored again. Please load it again first.\n");
+				return;
+			}
+			
+			// a viewed A is copied into the LIL-C format here, since the factorization modifies it
+			if (!A_view.empty()) {
+				A.load(A_view.ptr, A_view.row, A_view.val, A_view.n);
+				perm.clear();
+			}
+			
 			perm.reserve(A.n_cols());
-			cout << std::fixed << std::setprecision(3);
+			if (msg_lvl) cout << std::fixed << std::setprecision(3);
 			
 			double dif, total = 0;
-			clock_t start;
+			std::chrono::steady_clock::time_point start;
 			
 			if (equil_type == equilibration_type::BUNCH) {
-				start = clock();
+				start = std::chrono::steady_clock::now();
 				A.sym_equil();
-				dif = clock() - start; total += dif; 
-				if (msg_lvl) printf("  Equilibration:\t\t%.3f seconds.\n", dif/CLOCKS_PER_SEC);
+				dif = seconds_since(start); total += dif; 
+				if (msg_lvl) printf("  Equilibration:\t\t%.3f seconds.\n", dif);
+			}
+
+			// static pivoting uses a fixed 2x2 block structure, which is found before
+			// reordering so that the ordering can keep each pair together.
+			A.mate.clear();
+			if (piv_type == pivot_type::STATIC && !perform_inplace) {
+				start = std::chrono::steady_clock::now();
+				A.sym_match();
+				dif = seconds_since(start); total += dif;
+				if (msg_lvl) printf("  Matching:\t\t\t%.3f seconds.\n", dif);
 			}
 
 			if (reorder_type != reordering_type::NONE) {
-				start = clock();
+				start = std::chrono::steady_clock::now();
 				std::string perm_name;
 				switch (reorder_type) {
 					case reordering_type::AMD:
@@ -298,168 +553,649 @@ class solver {
 						A.sym_rcm(perm);
 						perm_name = "RCM";
 						break;
+					case reordering_type::PAR_AMD:
+						A.sym_amd_par(perm);
+						perm_name = "Parallel AMD";
+						break;
 				}
 				
-				dif = clock() - start; total += dif;
-				if (msg_lvl) printf("  %s:\t\t\t\t%.3f seconds.\n", perm_name.c_str(), dif/CLOCKS_PER_SEC);
+				A.pair_perm(perm);
+				dif = seconds_since(start); total += dif;
+				if (msg_lvl) printf("  %s:\t\t\t\t%.3f seconds.\n", perm_name.c_str(), dif);
 				
-				start = clock();
+				start = std::chrono::steady_clock::now();
 				A.sym_perm(perm);
-				dif = clock() - start; total += dif;
-				if (msg_lvl) printf("  Permutation:\t\t\t%.3f seconds.\n", dif/CLOCKS_PER_SEC);
+				dif = seconds_since(start); total += dif;
+				if (msg_lvl) printf("  Permutation:\t\t\t%.3f seconds.\n", dif);
 			} else {
 				// no permutation specified, store identity permutation instead.
 				for (int i = 0; i < A.n_cols(); i++) {
 					perm.push_back(i);
 				}
+				
+				if (!A.mate.empty()) {
+					A.pair_perm(perm);
+					A.sym_perm(perm);
+				}
 			}
 
-			start = clock();
+			const bool mixed = is_mixed();
+			start = std::chrono::steady_clock::now();
             if (perform_inplace) {
-                A.ildl_inplace(D, perm, fill_factor, tol, pp_tol, piv_type);
+                A.max_neg_pivots = max_neg;
+                A.peak_bytes = 0;
+                A.ildl_inplace(D, perm, fill_factor, tol, pp_tol, piv_type, fws);
+            } else if (mixed) {
+                // factor a single precision copy of A, leaving A for the residuals
+                vector<int> ptr(1, 0), row;
+                vector<float> val;
+                row.reserve(A.nnz()); val.reserve(A.nnz());
+                norm_A = 0;
+                vector<double> row_sum(A.n_cols(), 0);
+                for (int j = 0; j < A.n_cols(); j++) {
+                    for (int k = 0; k < (int) A.m_idx[j].size(); k++) {
+                        row.push_back(A.m_idx[j][k]);
+                        val.push_back((float) A.m_x[j][k]);
+                        row_sum[A.m_idx[j][k]] += abs(A.m_x[j][k]);
+                        if (A.m_idx[j][k] != j) row_sum[j] += abs(A.m_x[j][k]);
+                    }
+                    ptr.push_back(row.size());
+                }
+                for (int j = 0; j < A.n_cols(); j++) norm_A = std::max(norm_A, row_sum[j]);
+                
+                lilc_matrix<float> Af;
+                Af.load(ptr, row, val);
+                piv_perm.resize(A.n_cols());
+                for (int i = 0; i < A.n_cols(); i++) piv_perm[i] = i;
+                Af.max_neg_pivots = A.max_neg_pivots = max_neg;
+                Af.mate = A.mate;
+                Af.mem_budget = mem_budget;
+                Af.ooc_file = ooc_file;
+                Af.ooc_window = ooc_window;
+                Af.checkpoint_file = checkpoint_file;
+                Af.checkpoint_interval = checkpoint_interval;
+                Af.ildl(Lf, Df, piv_perm, fill_factor, tol, pp_tol, piv_type);
+                A.peak_bytes = Af.peak_bytes;
+                A.num_perturbed = Af.num_perturbed;
+                A.num_neg_pivots = Af.num_neg_pivots;
+                A.resumed_at = Af.resumed_at;
             } else {
-                A.ildl(L, D, perm, fill_factor, tol, pp_tol, piv_type);
+                // with adaptive shifting, the equilibrated and permuted A is kept, so that
+                // on a breakdown A + alpha*I can be refactored without redoing the rest.
+                A.max_neg_pivots = max_neg;
+                A.mem_budget = mem_budget;
+                A.ooc_file = ooc_file;
+                A.ooc_window = ooc_window;
+                A.checkpoint_file = checkpoint_file;
+                A.checkpoint_interval = checkpoint_interval;
+                mat_type A0;
+                vector<int> perm0;
+                if (shift_tries > 0) {
+                    A0 = A;
+                    perm0 = perm;
+                }
+                
+                diag_shift = 0;
+                A.ildl(L, D, perm, fill_factor, tol, pp_tol, piv_type, fws);
+                for (int t = 0; t < shift_tries && broke_down(); t++) {
+                    diag_shift = (diag_shift == 0 ? shift_init : 10*diag_shift);
+                    A = A0;
+                    perm = perm0;
+                    A.shift_diagonal(diag_shift);
+                    A.ildl(L, D, perm, fill_factor, tol, pp_tol, piv_type, fws);
+                }
+                
+                // the solves are with A itself, so the shift is taken back out
+                if (diag_shift != 0) A.shift_diagonal(-diag_shift);
             }
-			dif = clock() - start; total += dif;
+			dif = seconds_since(start); total += dif;
 			
             std::string pivot_name;
             if (piv_type == pivot_type::BKP) {
                 pivot_name = "BK";
             } else if (piv_type == pivot_type::ROOK) {
                 pivot_name = "Rook";
+            } else if (piv_type == pivot_type::STATIC) {
+                pivot_name = "Static";
             }
             
-			if (msg_lvl) printf("  Factorization (%s pivoting):\t%.3f seconds.\n", pivot_name.c_str(), dif/CLOCKS_PER_SEC);
-			if (msg_lvl) printf("Total time:\t\t\t%.3f seconds.\n", total/CLOCKS_PER_SEC);
+			if (msg_lvl) printf("  Factorization (%s pivoting%s):\t%.3f seconds.\n", pivot_name.c_str(), (mixed ? ", single precision" : ""), dif);
+			if (msg_lvl && A.resumed_at >= 0) printf("  Resumed from checkpoint:\tcolumn %d\n", A.resumed_at);
+			if (msg_lvl && A.num_perturbed > 0) printf("  Perturbed pivots:\t\t%d\n", A.num_perturbed);
+			if (msg_lvl && mem_budget > 0) printf("  Peak factor storage:\t\t%.1f MB (budget %.1f MB)\n", A.peak_bytes/1048576.0, mem_budget/1048576.0);
+			if (mem_budget > 0 && A.peak_bytes > mem_budget) {
+				std::cerr << "Warning: the memory budget of " << mem_budget/1048576.0 << " MB is too small for the factors, which took " << A.peak_bytes/1048576.0 << " MB with no entries off the diagonal of L. The budget was not kept." << std::endl;
+			}
+			if (msg_lvl && (mixed ? (bool) Lf.ooc : (!perform_inplace && L.ooc))) {
+				long long on_disk = (mixed ? Lf.ooc->file_end : L.ooc->file_end);
+				int evicted = (mixed ? Lf.ooc->num_evicted : L.ooc->num_evicted);
+				printf("  Out of core:\t\t\t%.1f MB on disk (%d of %d columns)\n", on_disk/1048576.0, evicted, A.n_cols());
+			}
+			if (msg_lvl && shift_tries > 0) printf("  Diagonal shift:\t\t%e%s\n", diag_shift, (broke_down() ? " (still broken down)" : ""));
+			if (msg_lvl && stopped_early()) printf("  Stopped early:\t\tmore than %d negative pivots.\n", max_neg);
+			if (msg_lvl) printf("Total time:\t\t\t%.3f seconds.\n", total);
             if (perform_inplace) {
                 if (msg_lvl) printf("L is %d by %d with %d non-zeros.\n", A.n_rows(), A.n_cols(), A.nnz() );
+            } else if (mixed) {
+                if (msg_lvl) printf("L is %d by %d with %d non-zeros (single precision).\n", Lf.n_rows(), Lf.n_cols(), Lf.nnz() );
             } else {
                 if (msg_lvl) printf("L is %d by %d with %d non-zeros.\n", L.n_rows(), L.n_cols(), L.nnz() );
             }
 			if (msg_lvl) printf("\n");
 			fflush(stdout);
 			
-			// if there is a right hand side, it means the user wants a solve.
-			// TODO: refactor this solve to be in its own method, and separate 
-			// factoring/minres solve phase
-			if (has_rhs) {
-                if (perform_inplace) {
-                    if (msg_lvl) printf("Inplace factorization cannot be used with the solver. Please try again without -inplace.\n");
-                } else {
-                    // start timer in case we're doing a full solve
-                    start = clock();
-                    
-                    // we've permuted and equilibrated the matrix, so we gotta apply 
-                    // the same permutation and equilibration to the right hand side.
-                    // i.e. rhs = P'S*rhs
-                    // 0. apply S
-                    for (int i = 0; i < A.n_cols(); i++) {
-                        rhs[i] = A.S[i]*rhs[i];
-                    }
-                    
-                    // 1. apply P' (takes rhs[perm[i]] to rhs[i], i.e. inverse of perm, 
-                    //    where perm takes i to perm[i])
-                    vector<el_type> tmp(A.n_cols());
-                    for (int i = 0; i < A.n_cols(); i++) {
-                        tmp[i] = rhs[perm[i]];
-                    }
-                    rhs = tmp;
-                    
-                    if (solve_type == solver_type::FULL) {
-                        if (msg_lvl) printf("Solving matrix with direct solver...\n");
-                        sol_vec.resize(A.n_cols(), 0);
-                        // MINRES uses the preconditioned solver that
-                        // splits the block D into |D|^(1/2).
-                        // For the full solver we'll just solve D directly.
-                        L.backsolve(rhs, sol_vec);
-                        D.solve(sol_vec, tmp);
-                        L.forwardsolve(tmp, sol_vec);
-                    } else {
-                        start = clock();
-						
-						if (solve_type == solver_type::MINRES) {
-							// finally, since we're preconditioning with M = L|D|^(1/2), we have
-							// to multiply M^(-1) to the rhs and solve the system
-							// M^(-1) * B * M'^(-1) y = M^(-1)P'*S*b
-							L.backsolve(rhs, tmp);
-							D.sqrt_solve(tmp, rhs, false);
-							
-							if (msg_lvl) printf("Solving matrix with MINRES...\n");
-							// solve the equilibrated, preconditioned, and permuted linear system
-							minres(max_iter, minres_tol, shift);
-							
-							// now we've solved M^(-1)*B*M'^(-1)y = M^(-1)P'*S*b
-							// where B = P'SASPy.
-							
-							// but the actual solution is y = M' * P'S^(-1)*x
-							// so x = S*P*M'^(-1)*y
-							
-							// 0. apply M'^(-1)
-							D.sqrt_solve(sol_vec, tmp, true);
-							L.forwardsolve(tmp, sol_vec);
-						} else if (solve_type == solver_type::SQMR) {
-							if (msg_lvl) printf("Solving matrix with SQMR...\n");
-							sqmr(max_iter, minres_tol);
+			iperm.resize(perm.size());
+			for (int i = 0; i < (int) perm.size(); i++) iperm[perm[i]] = i;
+			
+			work.resize(A.n_cols());
+			factor_id = next_factor_id();
+			
+			A_csr.clear();
+			if (csr_spmv && !perform_inplace) {
+				start = std::chrono::steady_clock::now();
+				if (A_view.empty()) {
+					A_csr.build(A.n_cols(), [&](auto visit) {
+						for (int j = 0; j < A.n_cols(); j++) {
+							for (int k = 0; k < (int) A.m_idx[j].size(); k++) visit(A.m_idx[j][k], j, A.m_x[j][k]);
 						}
-                    }
-            
-                    // 1. apply P
-                    for (int i = 0; i < A.n_cols(); i++) {
-                        tmp[perm[i]] = sol_vec[i];
-                    }
-                    sol_vec = tmp;
-                    
-                    // 2. apply S
-                    for (int i = 0; i < A.n_cols(); i++) {
-                        sol_vec[i] = A.S[i]*sol_vec[i];
-                    }
-                    dif = clock() - start;
-                    if (msg_lvl) printf("Solve time:\t%.3f seconds.\n", dif/CLOCKS_PER_SEC);
-                    if (msg_lvl) printf("\n");
-        
-		if (save_sol) {            
-                    // save results
-                    // TODO: refactor this to be in its own method
-                    if (msg_lvl) printf("Solution saved to output_matrices/outsol.mtx.\n");
-                    save_vector(sol_vec, "output_matrices/outsol.mtx");
-                }
-
+					});
+				} else {
+					const vector<el_type>& s = A.S.main_diag;
+					A_csr.build(A_view.n, [&](auto visit) {
+						for (int j = 0; j < A_view.n; j++) {
+							for (int k = A_view.ptr[j]; k < A_view.ptr[j+1]; k++) {
+								const int i = A_view.row[k];
+								if (i >= j) visit(iperm[i], iperm[j], s[i]*A_view.val[k]*s[j]);
+							}
+						}
+					});
+				}
+				dif = seconds_since(start);
+				if (msg_lvl) printf("CSR copy of A built in %.3f seconds (%d non-zeros).\n\n", dif, A_csr.nnz());
+			}
+			
+			// from here on, the solves multiply with the view or the CSR copy, so the
+			// LIL-C storage of A is released (keeping its dimensions and the equilibration S)
+			if ((!A_view.empty() || !A_csr.empty()) && !perform_inplace) {
+				vector< vector<int> >().swap(A.m_idx);
+				vector< vector<el_type> >().swap(A.m_x);
+				vector< vector<int> >().swap(A.list);
+				vector<int>().swap(A.row_first);
+				vector<int>().swap(A.col_first);
+			}
 		}
+		
+		/*! \brief Performs a matrix-vector product with B = P'SASP, the permuted and equilibrated A that the iterative solvers work with. B is either its CSR copy (see set_csr_spmv()), the factored copy of A itself, or (after load_view()) is applied through the caller's arrays.
+			\param x the vector to be multiplied.
+			\param y a storage vector for the result.
+		*/
+		void multiply_A(const vector<el_type>& x, vector<el_type>& y) const {
+			if (!A_csr.empty()) {
+				A_csr.multiply(x, y);
+			} else if (A_view.empty()) {
+				A.multiply(x, y);
+			} else {
+				A_view.multiply(x, y, iperm, A.S.main_diag);
 			}
 		}
 		
-		/*! \brief Applies minres on A, preconditioning with factors L and D.
+		/*! \brief Solves Ax = b for a sparse right hand side b (e.g. a unit vector), with x = SP(LDL')^(-1)P'S*b.
+			
+			The nonzero pattern of each intermediate solution is found by a depth first search through the graph of L (as in Gilbert and Peierls' sparse LU), and only the columns of L in it are touched. The cost is then proportional to the flops actually needed, instead of O(n + nnz(L)). Only the factorization is applied (no iterative solver or refinement), and it is not available after an inplace, mixed precision or out-of-core factorization.
 			
+			\param b_idx the (distinct) indices of the nonzeros of b.
+			\param b_val the values of the nonzeros of b.
+			\param x_idx a storage vector for the indices of the nonzeros of x (in no particular order).
+			\param x_val a storage vector for the values of the nonzeros of x.
+			\param ws the workspace used for all temporary vectors.
+		*/
+		void sparse_solve(const vector<int>& b_idx, const vector<el_type>& b_val, vector<int>& x_idx, vector<el_type>& x_val, solver_workspace<el_type>& ws) const {
+			x_idx.clear(); x_val.clear();
+			if (perform_inplace || is_mixed() || L.ooc) {
+				if (msg_lvl) printf("Sparse solves need the factors L and D in memory, so they cannot be used with -inplace, -mixed or -ooc_file.\n");
+				return;
+			}
+			
+			const int n = A.n_cols();
+			ws.resize_sparse(n);
+			const vector<el_type>& s = A.S.main_diag;
+			vector<el_type>& y = ws.sparse_x;
+			
+			// y = P'S*b, scattered into the (all zero) dense vector y
+			ws.sparse_b.clear();
+			for (int j = 0; j < (int) b_idx.size(); j++) {
+				int i = iperm[b_idx[j]];
+				y[i] = s[b_idx[j]]*b_val[j];
+				ws.sparse_b.push_back(i);
+			}
+			
+			L.sparse_backsolve(ws.sparse_b, y, ws.sparse_idx, ws.sparse_mark, ws.sparse_stack);
+			D.sparse_solve(y, ws.sparse_idx, ws.sparse_mark);
+			L.sparse_forwardsolve(ws.sparse_idx, y, ws.sparse_b, ws.sparse_mark, ws.sparse_stack);
+			
+			// x = SP*y, leaving y all zero again for the next solve
+			x_idx.reserve(ws.sparse_b.size()); x_val.reserve(ws.sparse_b.size());
+			for (int j = 0; j < (int) ws.sparse_b.size(); j++) {
+				int i = ws.sparse_b[j];
+				x_idx.push_back(perm[i]);
+				x_val.push_back(s[perm[i]]*y[i]);
+				y[i] = 0;
+			}
+		}
+		
+		/*! \brief Computes selected entries of SP(LDL')^(-1)P'S, the inverse of the factorization, by selected inversion (see lilc_matrix::selected_inverse()), i.e. its entries on the filled pattern of L. This includes the diagonal, so its diagonal costs about as much as one factorization instead of n solves.
+			
+			This is the inverse of A only if the factorization is exact, i.e. a full factorization (set_solver("full"), or -solver=full) without perturbed pivots. With the default incomplete factorization, it is the inverse of the preconditioner, which only approximates A^(-1).
+			
+			Like sparse_solve(), only the factorization is used, and it is not available after an inplace, mixed precision or out-of-core factorization.
+			
+			\param Z a storage matrix for the lower triangle of the selected entries of SP(LDL')^(-1)P'S, in the numbering of A as loaded.
+		*/
+		void selected_inverse(lilc_matrix<el_type>& Z) const {
+			const int n = A.n_cols();
+			Z.resize(n, n);
+			if (perform_inplace || is_mixed() || L.ooc) {
+				if (msg_lvl) printf("Selected inversion needs the factors L and D in memory, so it cannot be used with -inplace, -mixed or -ooc_file.\n");
+				return;
+			}
+			
+			lilc_matrix<el_type> Zp;
+			L.selected_inverse(D, Zp);
+			
+			// Z = SP*Zp*P'S, keeping the lower triangle
+			const vector<el_type>& s = A.S.main_diag;
+			for (int k = 0; k < n; k++) {
+				for (int p = 0; p < (int) Zp.m_idx[k].size(); p++) {
+					int i = perm[Zp.m_idx[k][p]], j = perm[k];
+					Z.m_idx[std::min(i, j)].push_back(std::max(i, j));
+					Z.m_x[std::min(i, j)].push_back(s[i]*s[j]*Zp.m_x[k][p]);
+				}
+			}
+			Z.nnz_count = Zp.nnz_count;
+		}
+		
+		/*! \brief Computes the diagonal of SP(LDL')^(-1)P'S, the inverse of the factorization, by selected inversion. This is diag(A^(-1)) only for an exact (full) factorization. See selected_inverse().
+			\param d a storage vector for the diagonal of the inverse of the factorization.
+		*/
+		void inverse_diagonal(vector<el_type>& d) const {
+			const int n = A.n_cols();
+			d.assign(n, 0);
+			if (perform_inplace || is_mixed() || L.ooc) {
+				if (msg_lvl) printf("Selected inversion needs the factors L and D in memory, so it cannot be used with -inplace, -mixed or -ooc_file.\n");
+				return;
+			}
+			
+			lilc_matrix<el_type> Zp;
+			L.selected_inverse(D, Zp);
+			
+			const vector<el_type>& s = A.S.main_diag;
+			for (int k = 0; k < n; k++) {
+				d[perm[k]] = s[perm[k]]*s[perm[k]]*Zp.m_x[k][0];
+			}
+		}
+		
+		/*! \brief Solves Ax = b for a sparse right hand side b using the solver's own workspace. See sparse_solve(b_idx, b_val, x_idx, x_val, ws).
+		*/
+		void sparse_solve(const vector<int>& b_idx, const vector<el_type>& b_val, vector<int>& x_idx, vector<el_type>& x_val) {
+			sparse_solve(b_idx, b_val, x_idx, x_val, work);
+		}
+		
+		/*! \brief Solves Ax = b using the factorization computed by factor(), with the solver chosen by set_solver().
+			
+			The right hand side is permuted and equilibrated, the system P'SASPy = P'Sb is solved, and x = SPy is returned. No memory is allocated if ws has been used for a system of this size before and x is already of the right size.
+			
+			This does not modify the solver, so any number of threads may solve against the same factorization at once, as long as each thread uses its own workspace.
+			
+			The iterative solvers can be warm started from an initial guess x0 (e.g. the solution of the last of a sequence of similar systems), which is passed in x. It is transformed the same way as the solution, i.e. y0 = P'S^(-1)*x0, and the solver starts from the residual r0 = P'S*b - P'SASP*y0. MINRES then solves for the correction to y0, which is the same as starting from M'*y0 on the preconditioned system. The guess is ignored by the full solve, and by MINRES when it is shifted.
+			
+			\param b the right hand side.
+			\param x a storage vector for the solution. If warm_start is true, it holds the initial guess on entry.
+			\param ws the workspace used for all temporary vectors.
+			\param warm_start set to true if x holds an initial guess.
+		*/
+		void solve(const vector<el_type>& b, vector<el_type>& x, solver_workspace<el_type>& ws, bool warm_start = false) const {
+			const int n = A.n_cols();
+			ws.resize(n);
+			if ((int) x.size() != n) {
+				x.resize(n);
+				warm_start = false;
+			}
+			
+			if (stopped_early()) {
+				if (msg_lvl) printf("The factorization was stopped early (see set_inertia_limit()), so it cannot be solved with.\n");
+				std::fill(x.begin(), x.end(), 0);
+				return;
+			}
+			
+			if (perform_inplace) {
+				if (msg_lvl) printf("Inplace factorization cannot be used with the solver. Please try again without -inplace.\n");
+				std::fill(x.begin(), x.end(), 0);
+				return;
+			}
+			
+			// we've permuted and equilibrated the matrix, so we gotta apply 
+			// the same permutation and equilibration to the right hand side,
+			// i.e. rhs = P'S*b (takes b[perm[i]] to rhs[i]), and to the solution,
+			// i.e. x = SP*sol (takes sol[i] to x[perm[i]]). where a triangular 
+			// solve comes first or last, this is folded into its sweep.
+			const vector<el_type>& s = A.S.main_diag;
+			
+			// perturbed pivots make LDL' inexact, so the full solve recovers the 
+			// lost accuracy with a few steps of iterative refinement.
+			int steps = max_refine;
+			if (steps < 0) steps = (piv_type == pivot_type::STATIC || diag_shift != 0 ? 3 : 0);
+			
+			if (is_mixed()) {
+				if (msg_lvl) printf("Solving matrix with mixed precision direct solver...\n");
+				for (int i = 0; i < n; i++) {
+					ws.rhs[i] = s[perm[i]]*b[perm[i]];
+				}
+				mixed_refine(ws, (max_refine < 0 ? 10 : max_refine));
+				for (int i = 0; i < n; i++) {
+					x[perm[i]] = s[perm[i]]*ws.sol[i];
+				}
+				return;
+			}
+			
+			if (solve_type == solver_type::FULL && steps == 0) {
+				if (msg_lvl) printf("Solving matrix with direct solver...\n");
+				// MINRES uses the preconditioned solver that
+				// splits the block D into |D|^(1/2).
+				// For the full solver we'll just solve D directly.
+				L.backsolve(b, ws.sol, perm, s);
+				D.solve(ws.sol, ws.tmp);
+				L.forwardsolve(ws.tmp, ws.tmp, x, perm, s);
+				return;
+			}
+			
+			if (solve_type == solver_type::MINRES) {
+				// since we're preconditioning with M = L|D|^(1/2), we have
+				// to multiply M^(-1) to the rhs and solve the system
+				// M^(-1) * B * M'^(-1) y = M^(-1)P'*S*b
+				L.backsolve(b, ws.tmp, perm, s);
+				D.sqrt_solve(ws.tmp, ws.rhs, false);
+				
+				// with an initial guess, y0 = P'S^(-1)*x0 is kept in ws.x and
+				// ws.r = M^(-1)(P'*S*b - B*y0) is the preconditioned initial residual.
+				bool guess = warm_start && minres_shift == 0;
+				if (guess) {
+					for (int i = 0; i < n; i++) {
+						ws.x[i] = x[perm[i]]/s[perm[i]];
+					}
+					multiply_A(ws.x, ws.r);
+					for (int i = 0; i < n; i++) {
+						ws.r[i] = s[perm[i]]*b[perm[i]] - ws.r[i];
+					}
+					L.backsolve(ws.r, ws.tmp);
+					D.sqrt_solve(ws.tmp, ws.r, false);
+				}
+				
+				if (msg_lvl) printf("Solving matrix with MINRES...\n");
+				// solve the equilibrated, preconditioned, and permuted linear system
+				if (pipelined && recycle_dim == 0) {
+					pminres(ws, max_iters, solver_tol, minres_shift, guess);
+				} else {
+					minres(ws, max_iters, solver_tol, minres_shift, guess);
+				}
+				
+				// now we've solved M^(-1)*B*M'^(-1)y = M^(-1)P'*S*b
+				// where B = P'SASP. but the actual solution is M'^(-1)*y
+				D.sqrt_solve(ws.sol, ws.tmp, true);
+				if (guess) {
+					L.forwardsolve(ws.tmp, ws.sol);
+					for (int i = 0; i < n; i++) {
+						x[perm[i]] = s[perm[i]]*(ws.x[i] + ws.sol[i]);
+					}
+				} else {
+					L.forwardsolve(ws.tmp, ws.sol, x, perm, s);
+				}
+				return;
+			}
+			
+			for (int i = 0; i < n; i++) {
+				ws.rhs[i] = s[perm[i]]*b[perm[i]];
+			}
+			
+			// the initial guess y0 = P'S^(-1)*x0 for SQMR
+			bool guess = warm_start && solve_type != solver_type::FULL;
+			if (guess) {
+				for (int i = 0; i < n; i++) {
+					ws.sol[i] = x[perm[i]]/s[perm[i]];
+				}
+			}
+			
+			if (solve_type == solver_type::FULL) {
+				if (msg_lvl) printf("Solving matrix with direct solver...\n");
+				L.backsolve(ws.rhs, ws.sol);
+				D.solve(ws.sol, ws.tmp);
+				L.forwardsolve(ws.tmp, ws.sol);
+				refine(ws, steps);
+			} else if (solve_type == solver_type::SQMR) {
+				if (msg_lvl) printf("Solving matrix with SQMR...\n");
+				if (pipelined) {
+					psqmr(ws, max_iters, solver_tol, check_every, guess);
+				} else {
+					sqmr(ws, max_iters, solver_tol, check_every, guess);
+				}
+			} else if (solve_type == solver_type::GMRES || solve_type == solver_type::FGMRES) {
+				bool flexible = (solve_type == solver_type::FGMRES);
+				if (msg_lvl) printf("Solving matrix with %s...\n", (flexible ? "FGMRES" : "GMRES"));
+				gmres(ws, max_iters, solver_tol, gmres_restart, gmres_reorth, flexible, guess);
+			}
+			
+			for (int i = 0; i < n; i++) {
+				x[perm[i]] = s[perm[i]]*ws.sol[i];
+			}
+		}
+		
+		/*! \brief Solves Ax = b using the factorization computed by factor() and the solver's own workspace. See solve(b, x, ws).
+			
+			Since the workspace is shared, this must not be called from several threads at once. Use solve(b, x, ws) with one workspace per thread instead.
+		*/
+		void solve(const vector<el_type>& b, vector<el_type>& x, bool warm_start = false) {
+			solve(b, x, work, warm_start);
+		}
+		
+		/*! \brief Factors the matrix A and, if a right hand side was loaded with set_rhs(), solves for it (the solution is stored in sol_vec). The iterative solver starts from the initial guess loaded with set_initial_guess(), if any.
+			
+			\param fill_factor a factor controling memory usage of factorization.
+			\param tol a factor controling accuracy of factorization.
+			\param pp_tol a factor controling the aggresiveness of Bunch-Kaufman pivoting.
+			\param max_iter the maximum number of iterations for the iterative solver (ignored if no right hand side).
+			\param minres_tol the stopping tolerance of the iterative solver.
+			\param shift the shift used by MINRES.
+		*/
+		void solve(double fill_factor, double tol, double pp_tol, int max_iter = -1, double minres_tol = 1e-6, double shift = 0.0) {
+			set_solver_params(max_iter, minres_tol, shift);
+			factor(fill_factor, tol, pp_tol);
+			
+			if (has_rhs) {
+				if (perform_inplace) {
+					if (msg_lvl) printf("Inplace factorization cannot be used with the solver. Please try again without -inplace.\n");
+					return;
+				}
+				
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				solve(rhs, sol_vec, has_guess);
+				double dif = seconds_since(start);
+				if (msg_lvl) printf("Solve time:\t%.3f seconds.\n", dif);
+				if (msg_lvl) printf("\n");
+				
+				if (save_sol) {
+					// save results
+					// TODO: refactor this to be in its own method
+					if (msg_lvl) printf("Solution saved to output_matrices/outsol.mtx.\n");
+					save_vector(sol_vec, "output_matrices/outsol.mtx");
+				}
+			}
+		}
+		
+		/*! \return True if the last factorization broke down, i.e. it has entries in L larger than allowed by set_adaptive_shift(), perturbed pivots, or was stopped early.
+		*/
+		bool broke_down() const {
+			return A.pivot_growth > max_growth || A.num_perturbed > 0 || stopped_early();
+		}
+		
+		/*! \return True if the last factorization was stopped because it had more negative pivots than allowed by set_inertia_limit().
+		*/
+		bool stopped_early() const {
+			return max_neg >= 0 && A.num_neg_pivots > max_neg;
+		}
+		
+		/*! \brief Computes the inertia of A from the blocks of D, i.e. the numbers of positive, negative and zero eigenvalues of LDL' (which are those of A when the factorization is exact). The inertia is not changed by the equilibration and permutation.
+			\param npos the number of positive eigenvalues.
+			\param nneg the number of negative eigenvalues.
+			\param nzero the number of zero eigenvalues.
+		*/
+		void inertia(int& npos, int& nneg, int& nzero) const {
+			if (is_mixed()) Df.inertia(npos, nneg, nzero);
+			else D.inertia(npos, nneg, nzero);
+		}
+		
+		/*! \brief Computes log|det(A)| from the blocks of D and the equilibration, i.e. log|det(D)| - 2*log|det(S)| (exact when the factorization is exact).
+			\param sign if not NULL, the sign of det(A) is stored here (0 if A is singular).
+			\return log|det(A)|.
+		*/
+		double log_det(int* sign = NULL) const {
+			double res = (is_mixed() ? Df.log_abs_det(sign) : D.log_abs_det(sign));
+			const vector<el_type>& s = A.S.main_diag;
+			for (int i = 0; i < (int) s.size(); i++) {
+				res -= 2*log(abs(s[i]));
+			}
+			return res;
+		}
+		
+		/*! \return True if the factorization is done in single precision (see set_mixed_precision()).
+		*/
+		bool is_mixed() const {
+			return mixed_precision && solve_type == solver_type::FULL && !perform_inplace;
+		}
+		
+		/*! \brief Solves the permuted and equilibrated system (right hand side ws.rhs, solution ws.sol) with the single precision factors Lf and Df, followed by iterative refinement with residuals computed in double precision. The normwise backward error achieved is printed.
+			
+			\param ws the workspace holding the system being solved.
+			\param max_steps the maximum number of refinement steps. Refinement also stops once the backward error reaches machine precision or stops decreasing quickly.
+		*/
+		void mixed_refine(solver_workspace<el_type>& ws, int max_steps) const;
+		
+		/*! \brief Performs iterative refinement on ws.sol using the factors L and D, i.e. x += (LDL')^(-1) * (b - Ax), where A, b and x are the permuted and equilibrated matrix, right hand side (ws.rhs) and solution (ws.sol).
+			
+			\param ws the workspace holding the system being solved.
+			\param max_steps the maximum number of refinement steps. Refinement also stops once the residual stops decreasing.
+		*/
+		void refine(solver_workspace<el_type>& ws, int max_steps) const;
+		
+		/*! \brief Applies minres on A, preconditioning with factors L and D. The preconditioned right hand side is read from ws.rhs, and the solution is stored in ws.sol.
+			
+			\param ws the workspace used for all temporary vectors.
 			\param max_iter the maximum number of minres iterations.
 			\param stop_tol the stopping tolerance of minres. i.e. we stop as soon as the residual goes below stop_tol.
 			\param shift shifts A by shift*(identity matrix) to make it more positive definite. This sometimes helps.
+			\param guess if true, ws.r holds the preconditioned residual of an initial guess, and the correction to the guess is stored in ws.sol.
+		*/
+		void minres(solver_workspace<el_type>& ws, int max_iter = 1000, double stop_tol = 1e-6, double shift = 0.0, bool guess = false) const;
+		
+		/*! \brief Applies restarted GMRES(m) on A, right preconditioned with factors L and D. The right hand side is read from ws.rhs, and the solution is stored in ws.sol.
+			
+			The krylov basis is preallocated in ws, and is orthogonalised by classical Gram-Schmidt, computing all inner products with a new vector in a single pass over it.
+			
+			\param ws the workspace used for all temporary vectors.
+			\param max_iter the maximum number of gmres iterations (over all restarts).
+			\param stop_tol the stopping tolerance of gmres. i.e. we stop as soon as the residual goes below stop_tol.
+			\param restart the restart length m.
+			\param reorth if true, Gram-Schmidt is done twice for every new basis vector.
+			\param flexible if true, FGMRES is used, which stores the preconditioned basis as well and so allows the preconditioner (see set_preconditioner()) to change between iterations.
+			\param guess if true, ws.sol holds an initial guess on entry.
+		*/
+		void gmres(solver_workspace<el_type>& ws, int max_iter = 1000, double stop_tol = 1e-6, int restart = 30, bool reorth = false, bool flexible = false, bool guess = false) const;
+		
+		/*! \brief Projects out the recycled subspace: y = P*y, where P = I - W*E^(-1)*U'. MINRES with recycling solves the (symmetric) deflated system P*B*z = P*r0.
+		*/
+		void deflate(const solver_workspace<el_type>& ws, vector<el_type>& y) const;
+		
+		/*! \brief Recovers the solution of B*z = r0 from the solution z of the deflated system, i.e. z = U*E^(-1)*U'*r0 + P'*z.
+		*/
+		void undeflate(solver_workspace<el_type>& ws, const vector<el_type>& r0, vector<el_type>& z) const;
+		
+		/*! \brief Makes ws.U the recycle_dim Ritz vectors of the preconditioned matrix in span([ws.U, ws.Z]) with the smallest Ritz values (in magnitude).
+			\param p the number of columns of ws.Z used. [ws.U, ws.Z] must be orthonormal, and ws.BZ the products of the preconditioned matrix with ws.Z.
+		*/
+		void recycle_space(solver_workspace<el_type>& ws, int p, double shift) const;
+		
+		/*! \brief Drops ws.U if it was found with another factorization, and updates ws.W and ws.E if it was found with another shift.
 		*/
-		void minres(int max_iter = 1000, double stop_tol = 1e-6, double shift = 0.0);
+		void recycle_refresh(solver_workspace<el_type>& ws, double shift) const;
 		
-		/*! \brief Applies SMQR on A, preconditioning with factors L and D.
+		/*! \brief Updates the recycled subspace with the Ritz vectors from the first m lanczos vectors of the last MINRES solve.
+		*/
+		void recycle_update(solver_workspace<el_type>& ws, int m, double shift) const;
+		
+		/*! \brief Applies SMQR on A, preconditioning with factors L and D. The right hand side is read from ws.rhs, and the solution is stored in ws.sol.
+			
+			\param ws the workspace used for all temporary vectors.
+			\param max_iter the maximum number of minres iterations.
+			\param stop_tol the stopping tolerance of minres. i.e. we stop as soon as the residual goes below stop_tol.
+			\param check_every the residual is only computed (and the best iterate saved) every check_every iterations.
+			\param guess if true, ws.sol holds an initial guess on entry.
+		*/
+		void sqmr(solver_workspace<el_type>& ws, int max_iter = 1000, double stop_tol = 1e-6, int check_every = 1, bool guess = false) const;
+		
+		/*! \brief Pipelined version of minres(). The Lanczos vectors are updated together with their products with the preconditioned operator, so that each iteration needs a single fused reduction instead of several. Only the number of synchronisation points is reduced: the reduction is not overlapped with the application of the operator, which waits for it.
 			
+			\param ws the workspace used for all temporary vectors.
 			\param max_iter the maximum number of minres iterations.
 			\param stop_tol the stopping tolerance of minres. i.e. we stop as soon as the residual goes below stop_tol.
+			\param shift shifts A by shift*(identity matrix) to make it more positive definite. This sometimes helps.
+			\param guess if true, ws.r holds the preconditioned residual of an initial guess, and the correction to the guess is stored in ws.sol.
 		*/
-		void sqmr(int max_iter = 1000, double stop_tol = 1e-6);
+		void pminres(solver_workspace<el_type>& ws, int max_iter = 1000, double stop_tol = 1e-6, double shift = 0.0, bool guess = false) const;
+		
+		/*! \brief Pipelined version of sqmr(), based on the pipelined preconditioned CG recurrences of Ghysels and Vanroose (2014). Each iteration needs a single fused reduction instead of several. Only the number of synchronisation points is reduced: the reduction is not overlapped with the application of the preconditioner and A, which wait for it.
+			
+			\param ws the workspace used for all temporary vectors.
+			\param max_iter the maximum number of sqmr iterations.
+			\param stop_tol the stopping tolerance of sqmr. i.e. we stop as soon as the residual goes below stop_tol.
+			\param check_every the best iterate is only saved every check_every iterations.
+			\param guess if true, ws.sol holds an initial guess on entry.
+		*/
+		void psqmr(solver_workspace<el_type>& ws, int max_iter = 1000, double stop_tol = 1e-6, int check_every = 1, bool guess = false) const;
 		
 		/*! \brief Save results of factorization (automatically saved into the output_matrices folder).
 			
 			The names of the output matrices follow the format out{}.mtx, where {} describes what the file contains (i.e. A, L, or D).
+			
+			\param prefix the path each filename starts with, e.g. "output_matrices/out3_" to keep the factors of several matrices apart.
 		*/
-		void save() { // TODO: refactor this as a "save factors" method
+		void save(const std::string& prefix = "output_matrices/out") { // TODO: refactor this as a "save factors" method
 			if (msg_lvl) cout << "Saving matrices..." << endl;
+            if (is_mixed()) {
+                // the factors are of A permuted by piv_perm as well, so only
+                // the factors and the combined permutation are saved
+                Lf.save(prefix + "L.mtx", false);
+                Df.save(prefix + "D.mtx");
+                vector<int> full_perm(perm.size());
+                for (int i = 0; i < (int) perm.size(); i++) full_perm[i] = perm[piv_perm[i]];
+                save_vector(full_perm, prefix + "P.mtx");
+                A.S.save(prefix + "S.mtx");
+                if (msg_lvl) cout << "Save complete." << endl;
+                return;
+            }
+            
             if (!perform_inplace) {
-                A.save("output_matrices/outB.mtx", true);
-                L.save("output_matrices/outL.mtx", false);
+                if (!A_csr.empty()) {
+                    A_csr.save(prefix + "B.mtx");
+                } else if (A_view.empty()) {
+                    A.save(prefix + "B.mtx", true);
+                }
+                L.save(prefix + "L.mtx", false);
             } else {
-                A.save("output_matrices/outL.mtx", false);
+                A.save(prefix + "L.mtx", false);
             }
             
-			A.S.save("output_matrices/outS.mtx");
-			save_vector(perm, "output_matrices/outP.mtx");
+			A.S.save(prefix + "S.mtx");
+			save_vector(perm, prefix + "P.mtx");
 			
-			D.save("output_matrices/outD.mtx");
+			D.save(prefix + "D.mtx");
 			if (msg_lvl) cout << "Save complete." << endl;
 		}
 		
@@ -478,8 +1214,15 @@ class solver {
 		}
 };
 
+#include "solver_refine.h"
 #include "solver_minres.h"
 #include "solver_sqmr.h"
+#include "solver_pminres.h"
+#include "solver_recycle.h"
+#include "solver_gmres.h"
+#include "solver_mixed.h"
+#include "solver_psqmr.h"
+#include "solver_batch.h"
 
 }
 
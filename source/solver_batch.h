@@ -0,0 +1,88 @@
+//-*- mode: c++ -*-
+#ifndef _SOLVER_BATCH_H_
+#define _SOLVER_BATCH_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*! \return The number of threads a batch is run on, given the number asked for (0 for all available).
+*/
+inline int batch_threads(int num_threads) {
+#ifdef _OPENMP
+	return (num_threads > 0 ? num_threads : omp_get_max_threads());
+#else
+	return 1;
+#endif
+}
+
+/*! \return True if no two of the solvers share an out-of-core or checkpoint file (see solver::set_out_of_core() and solver::set_checkpoint()).
+*/
+template<class el_type, class mat_type>
+bool batch_files_distinct(const vector< solver<el_type, mat_type> >& solvers) {
+	std::set<std::string> seen;
+	for (int i = 0; i < (int) solvers.size(); i++) {
+		const std::string* files[2] = {&solvers[i].ooc_file, &solvers[i].checkpoint_file};
+		for (int f = 0; f < 2; f++) {
+			if (!files[f]->empty() && !seen.insert(*files[f]).second) return false;
+		}
+	}
+	return true;
+}
+
+/*! \brief Factors many independent matrices at once, one matrix per thread at a time. Each solver must have its matrix loaded and its options set (it is best to set their message level to "none", since the statistics of concurrent factorizations are printed interleaved).
+
+	Each thread keeps one ildl_workspace for all the matrices it factors, so that the work vectors are allocated once per thread instead of once per matrix. The matrices are handed out dynamically, so a mix of small and large matrices is balanced across the threads.
+	
+	The factorizations run concurrently, so every solver needs out-of-core and checkpoint files of its own: an out-of-core factorization truncates its file when it starts and removes it when the solver is destroyed, and a checkpoint is overwritten by whichever factorization saves last. A batch with shared files is rejected.
+
+	\param solvers the solvers to factor.
+	\param fill_factor a factor controling memory usage of factorization.
+	\param tol a factor controling accuracy of factorization.
+	\param pp_tol a factor controling the aggresiveness of Bunch-Kaufman pivoting.
+	\param num_threads the number of threads used (0 for all available).
+	\return False (and nothing is factored) if two of the solvers share an out-of-core or checkpoint file.
+*/
+template<class el_type, class mat_type>
+bool factor_batch(vector< solver<el_type, mat_type> >& solvers, double fill_factor, double tol, double pp_tol, int num_threads = 0) {
+	if (!batch_files_distinct(solvers)) {
+		std::cerr << "The solvers of a batch must not share out-of-core or checkpoint files." << std::endl;
+		return false;
+	}
+	
+	const int n = solvers.size();
+	#pragma omp parallel num_threads(batch_threads(num_threads))
+	{
+		ildl_workspace<el_type> fws;
+		#pragma omp for schedule(dynamic, 1)
+		for (int i = 0; i < n; i++) {
+			solvers[i].factor(fill_factor, tol, pp_tol, &fws);
+		}
+	}
+	return true;
+}
+
+/*! \brief Solves A_i x_i = b_i for many factored solvers at once (see factor_batch()), with the solver and options set in each. Each thread keeps one solver_workspace for all the systems it solves.
+
+	\param solvers the factored solvers.
+	\param b the right hand sides, one per solver. Solvers with an empty right hand side are skipped.
+	\param x a storage vector for the solutions.
+	\param num_threads the number of threads used (0 for all available).
+*/
+template<class el_type, class mat_type>
+void solve_batch(const vector< solver<el_type, mat_type> >& solvers, const vector< vector<el_type> >& b, vector< vector<el_type> >& x, int num_threads = 0) {
+	const int n = solvers.size();
+	x.resize(n);
+	#pragma omp parallel num_threads(batch_threads(num_threads))
+	{
+		solver_workspace<el_type> ws;
+		#pragma omp for schedule(dynamic, 1)
+		for (int i = 0; i < n; i++) {
+			if (b[i].empty()) continue;
+			x[i].resize(b[i].size());
+			solvers[i].solve(b[i], x[i], ws);
+		}
+	}
+}
+
+#endif // _SOLVER_BATCH_H_
@@ -0,0 +1,166 @@
+//-*- mode: c++ -*-
+#ifndef _SOLVER_GMRES_H_
+#define _SOLVER_GMRES_H_
+
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: gmres(solver_workspace<el_type>& ws, int max_iter, double stop_tol, int restart, bool reorth, bool flexible, bool guess) const {
+	const int n = A.n_rows(), par_min = 10000;
+	const int m = std::max(1, std::min(restart, n));
+	ws.resize_gmres(n, m, flexible);
+
+	// ---------- set initial values for variables ---------//
+	const vector<el_type>& rhs = ws.rhs;
+	vector<el_type>& sol_vec = ws.sol;
+	vector<el_type>& r = ws.r;
+	vector<el_type>& tmp = ws.tmp;
+	vector<el_type>& u = ws.d;
+
+	// the (preallocated) krylov basis V, and for FGMRES the preconditioned basis Z
+	vector<el_type>* V = &ws.basis[0];
+	vector<el_type>* Z = (flexible ? &ws.zbasis[0] : NULL);
+
+	// the hessenberg matrix H (stored column major, (m+1) by m), the givens
+	// rotations that make it upper triangular, and the rotated rhs g.
+	double* H = &ws.hess[0];
+	double* cs = &ws.givens[0];
+	double* sn = &ws.givens[m];
+	double* g = &ws.givens[2*m];
+	double* h = &ws.givens[3*m+1];
+	auto Hc = [&](int i, int j) -> double& { return H[i + j*(m+1)]; };
+
+	// Our preconditioner M = LDL' (or the one set with set_preconditioner() for FGMRES).
+	auto Minv = [&](const vector<el_type>& in, vector<el_type>& out) {
+		if (flexible && precond) {
+			precond(in, out);
+			return;
+		}
+		L.backsolve(in, out);
+		D.solve(out, tmp);
+		L.forwardsolve(tmp, out);
+	};
+
+	double norm_rhs = norm(rhs, 2.0);
+	if (norm_rhs == 0 || !guess) std::fill(sol_vec.begin(), sol_vec.end(), 0);
+	if (norm_rhs == 0) return;
+
+	// residual = b - A*x0
+	if (guess) {
+		multiply_A(sol_vec, r);
+		vector_sum(1, rhs, -1, r, r);
+	} else {
+		r = rhs;
+	}
+	double res = norm(r, 2.0);
+
+	int i, j, l;
+	int k = 0; // total iterations
+	int cycles = 0;
+	while (res/norm_rhs > stop_tol && k < max_iter) {
+		cycles++;
+
+		// V[0] = r/||r||, g = ||r||*e1
+		for (i = 0; i < n; i++) V[0][i] = r[i]/res;
+		std::fill(g, g + m + 1, 0);
+		g[0] = res;
+
+		// ---------- arnoldi process ----------//
+		for (j = 0; j < m && k < max_iter; ) {
+			// w = A*M^(-1)*V[j], formed in V[j+1]
+			vector<el_type>& z = (flexible ? Z[j] : u);
+			Minv(V[j], z);
+			multiply_A(z, V[j+1]);
+			vector<el_type>& w = V[j+1];
+
+			// classical gram-schmidt: h = V'*w in one pass over w (all j+1 inner
+			// products at once), then w = w - V*h in a second pass. with
+			// reorthogonalisation, this is done twice.
+			const int nb = j+1;
+			for (l = 0; l < nb; l++) Hc(l, j) = 0;
+			for (int pass = 0; pass < (reorth ? 2 : 1); pass++) {
+				std::fill(h, h + nb, 0);
+				#pragma omp parallel for private(l) reduction(+:h[:nb]) if(n > par_min)
+				for (i = 0; i < n; i++) {
+					const el_type wi = w[i];
+					for (l = 0; l < nb; l++) h[l] += V[l][i]*wi;
+				}
+
+				double hw = 0;
+				#pragma omp parallel for private(l) reduction(+:hw) if(n > par_min)
+				for (i = 0; i < n; i++) {
+					el_type wi = w[i];
+					for (l = 0; l < nb; l++) wi -= h[l]*V[l][i];
+					w[i] = wi;
+					hw += wi*wi;
+				}
+
+				for (l = 0; l < nb; l++) Hc(l, j) += h[l];
+				Hc(j+1, j) = sqrt(hw);
+			}
+
+			if (Hc(j+1, j) != 0) {
+				const double scale = 1.0/Hc(j+1, j);
+				for (i = 0; i < n; i++) w[i] *= scale;
+			}
+
+			// apply the previous givens rotations to the new column of H
+			for (l = 0; l < j; l++) {
+				double t = cs[l]*Hc(l, j) + sn[l]*Hc(l+1, j);
+				Hc(l+1, j) = -sn[l]*Hc(l, j) + cs[l]*Hc(l+1, j);
+				Hc(l, j) = t;
+			}
+
+			// and find the rotation that zeroes H(j+1, j)
+			double a = Hc(j, j), b = Hc(j+1, j);
+			double rho = sqrt(a*a + b*b);
+			if (rho == 0) {
+				cs[j] = 1; sn[j] = 0;
+			} else {
+				cs[j] = a/rho; sn[j] = b/rho;
+			}
+			Hc(j, j) = rho;
+			Hc(j+1, j) = 0;
+			g[j+1] = -sn[j]*g[j];
+			g[j] = cs[j]*g[j];
+
+			res = abs(g[j+1]);
+			j++; k++;
+
+			// an exact breakdown means the solution lies in the krylov space
+			if (res/norm_rhs <= stop_tol || b == 0) break;
+		}
+		// ---------- end arnoldi process ----------//
+
+		// solve the triangular system H*y = g (y is stored in g)
+		for (l = j-1; l >= 0; l--) {
+			for (i = l+1; i < j; i++) g[l] -= Hc(l, i)*g[i];
+			g[l] = (Hc(l, l) == 0 ? 0 : g[l]/Hc(l, l));
+		}
+
+		// x = x + M^(-1)*V*y (GMRES) or x = x + Z*y (FGMRES)
+		if (flexible) {
+			for (l = 0; l < j; l++) vector_sum(1, sol_vec, g[l], Z[l], sol_vec);
+		} else {
+			std::fill(r.begin(), r.end(), 0);
+			for (l = 0; l < j; l++) vector_sum(1, r, g[l], V[l], r);
+			Minv(r, u);
+			vector_sum(1, sol_vec, 1, u, sol_vec);
+		}
+
+		// restart from the true residual
+		multiply_A(sol_vec, r);
+		vector_sum(1, rhs, -1, r, r);
+		res = norm(r, 2.0);
+	}
+
+	std::string iter_str = "iterations";
+	if (k == 1) iter_str = "iteration";
+
+	if (msg_lvl) printf("%s(%d) took %i %s (%i %s) and got down to relative residual %e.\n", (flexible ? "FGMRES" : "GMRES"), m, k, iter_str.c_str(), cycles, (cycles == 1 ? "cycle" : "cycles"), res/norm_rhs);
+	return;
+}
+
+#endif // _SOLVER_GMRES_H_
@@ -7,17 +7,22 @@
 #include <cmath>
 
 template<class el_type, class mat_type >
-void solver<el_type, mat_type> :: minres(int max_iter, double stop_tol, double shift) {
-	//Zero out solution vector
+void solver<el_type, mat_type> :: minres(solver_workspace<el_type>& ws, int max_iter, double stop_tol, double shift, bool guess) const {
 	int n = A.n_rows();
-	sol_vec.resize(n, 0);
+	ws.resize(n);
+	
+	//Zero out solution vector
+	const vector<el_type>& rhs = ws.rhs;
+	vector<el_type>& sol_vec = ws.sol;
+	std::fill(sol_vec.begin(), sol_vec.end(), 0);
 	
-	// ---------- set initial values and allocate memory for variables ---------//
+	// ---------- set initial values for variables ---------//
 	el_type alpha[2], beta[2]; // the last two entries of the T matrix
 	el_type res[2]; // the last two residuals
 	
 	// the last two vectors of the lanczos iteration
-	vector< vector<el_type> > v(2, vector<el_type>(n));
+	vector<el_type>* v = ws.v;
+	std::fill(v[0].begin(), v[0].end(), 0);
 	
 	double norm_A = 0; // matrix norm estimate
 	double cond_A = 1;	// condition number estimate
@@ -29,24 +34,48 @@ void solver<el_type, mat_type> :: minres(int max_iter, double stop_tol, double s
 	delta1[1] = 0;
 	
 	// temporary vectors for lanczos calcluations
-	vector<el_type> pk(n), tk(n);
+	vector<el_type>& pk = ws.q;
+	vector<el_type>& tk = ws.t;
 	
 	// step size in the current search direction (xk = x_{k-1} + tau*dk)
 	double tau = 0;
 	
 	// the last 3 search directions
-	vector< vector<el_type> > d(2, vector<el_type>(n));
+	vector<el_type>* d = ws.w;
+	std::fill(d[0].begin(), d[0].end(), 0);
+	std::fill(d[1].begin(), d[1].end(), 0);
 	
 	// set up initial values for variables above
 	double eps = A.eps;
+	// with an initial guess, we solve for the correction to it, starting from
+	// the (preconditioned) initial residual r0 in ws.r instead of rhs.
+	const vector<el_type>& r0 = (guess ? ws.r : rhs);
+	
+	// with a recycled subspace U, we solve the deflated system P*B*z = P*r0 (see
+	// deflate()) and recover the solution of B*z = r0 at the end.
+	const bool recycling = recycle_dim > 0;
+	const int max_store = std::max(20, 3*recycle_dim); // lanczos vectors kept for the next U
+	if (recycling) {
+		ws.resize_recycle(n, recycle_dim, max_store);
+		recycle_refresh(ws, shift);
+		ws.d = r0;
+		deflate(ws, ws.d);
+	}
+	const vector<el_type>& p0 = (recycling ? ws.d : r0);
+	
 	beta[0] = 0;
-	beta[1] = norm(rhs, 2.0);
+	beta[1] = norm(p0, 2.0);
 	
-	double norm_rhs = beta[1];
+	double norm_rhs = norm(rhs, 2.0);
+	if (norm_rhs == 0) return;
+	if (beta[1] == 0) {
+		if (recycling) undeflate(ws, r0, sol_vec);
+		return;
+	}
 	
-	// v[1] = rhs/beta[1]
+	// v[1] = r0/beta[1]
 	for (int i = 0; i < n; i++) {
-		v[1][i] = rhs[i]/beta[1];
+		v[1][i] = p0[i]/beta[1];
 	}
 	
 	res[0] = beta[1];
@@ -65,7 +94,7 @@ void solver<el_type, mat_type> :: minres(int max_iter, double stop_tol, double s
 		L.forwardsolve(pk, tk);
 		
 		//pk = A*tk
-		A.multiply(tk, pk);
+		multiply_A(tk, pk);
 
 		//pk = |D|^(-1/2) L^(-1) pk. after this step, pk = M^(-1) A M^(-t) v[cur]
 		L.backsolve(pk, tk);
@@ -76,6 +105,9 @@ void solver<el_type, mat_type> :: minres(int max_iter, double stop_tol, double s
 			pk[i] -= shift * v[cur][i];
 		}
 		
+		//and project out the recycled subspace
+		if (recycling) deflate(ws, pk);
+		
 		// alpha = v[cur]' * pk
 		alpha[cur] = dot_product(v[cur], pk);
 		
@@ -93,6 +125,14 @@ void solver<el_type, mat_type> :: minres(int max_iter, double stop_tol, double s
 		}
 		// ---------- end lanczos step ----------//
 		
+		if (recycling && k <= max_store) {
+			ws.V[k-1] = v[cur];
+			ws.lan_alpha[k-1] = alpha[cur];
+			ws.lan_beta[k-1] = beta[nxt];
+		} else if (recycling && k == max_store+1) {
+			ws.V[k-1] = v[cur]; //the lanczos vector after the last one kept (see recycle_update())
+		}
+		
 		// left orthogonlization on the middle two entries in the last column of Tk
 		delta2[cur] = c*delta1[cur] + s*alpha[cur];
 		gamma1[cur] = s*delta1[cur] - c*alpha[cur];
@@ -161,6 +201,13 @@ void solver<el_type, mat_type> :: minres(int max_iter, double stop_tol, double s
 		//cout << "current residual " << res[cur]/norm_rhs << endl;
 	}
 	
+	if (recycling) {
+		undeflate(ws, r0, sol_vec);
+		//if the solve stopped before max_store, the vector after the last one kept is the next one
+		if (k-1 <= max_store) ws.V[k-1] = v[k%2];
+		recycle_update(ws, std::min(k-1, max_store), shift);
+	}
+	
 	if (msg_lvl) printf("The estimated condition number of the matrix is %e.\n", cond_A);
     
     std::string iter_str = "iterations";
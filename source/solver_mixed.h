@@ -0,0 +1,88 @@
+//-*- mode: c++ -*-
+#ifndef _SOLVER_MIXED_H_
+#define _SOLVER_MIXED_H_
+
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: mixed_refine(solver_workspace<el_type>& ws, int max_steps) const {
+	const int n = A.n_rows();
+	ws.resize(n);
+
+	const vector<el_type>& rhs = ws.rhs;
+	vector<el_type>& sol_vec = ws.sol;
+	vector<el_type>& r = ws.r;
+	vector<el_type>& dx = ws.d;
+	vector<float>& lo = ws.lo[0];
+	vector<float>& lo_tmp = ws.lo[1];
+	if ((int) lo.size() != n) {
+		lo.assign(n, 0);
+		lo_tmp.assign(n, 0);
+	}
+
+	// dx = (LDL')^(-1) * r with the single precision factors. these are of the
+	// matrix A further permuted by the pivoting done in ildl (piv_perm).
+	auto Minv = [&](const vector<el_type>& in, vector<el_type>& out) {
+		for (int i = 0; i < n; i++) {
+			lo_tmp[i] = (float) in[piv_perm[i]];
+		}
+		Lf.backsolve(lo_tmp, lo);
+		Df.solve(lo, lo_tmp);
+		Lf.forwardsolve(lo_tmp, lo);
+		for (int i = 0; i < n; i++) {
+			out[piv_perm[i]] = lo[i];
+		}
+	};
+
+	auto inf_norm = [&](const vector<el_type>& v) {
+		double res = 0;
+		for (int i = 0; i < n; i++) res = std::max(res, (double) abs(v[i]));
+		return res;
+	};
+
+	const double norm_rhs = inf_norm(rhs);
+	if (norm_rhs == 0) {
+		std::fill(sol_vec.begin(), sol_vec.end(), 0);
+		return;
+	}
+
+	// r = b - A*x, in double precision against the original A, and the normwise
+	// backward error of x, ||b - Ax|| / (||A|| ||x|| + ||b||) (in the inf-norm).
+	auto backward_error = [&]() {
+		multiply_A(sol_vec, r);
+		vector_sum(1, rhs, -1, r, r);
+		return inf_norm(r)/(norm_A * inf_norm(sol_vec) + norm_rhs);
+	};
+
+	const double eps = std::numeric_limits<double>::epsilon();
+	Minv(rhs, sol_vec);
+	double err = backward_error();
+
+	int k = 0;
+	while (k < max_steps && err > eps) {
+		Minv(r, dx);
+		vector_sum(1, sol_vec, 1, dx, sol_vec);
+		double err1 = backward_error();
+
+		// stop as soon as the correction no longer helps (or breaks down)
+		if (!(err1 < err)) {
+			vector_sum(1, sol_vec, -1, dx, sol_vec);
+			break;
+		}
+
+		k++;
+		bool stalled = (err1 > 0.5*err);
+		err = err1;
+		if (stalled) break;
+	}
+
+	std::string step_str = "steps";
+	if (k == 1) step_str = "step";
+
+	if (msg_lvl) printf("Mixed precision solve took %i refinement %s and got down to backward error %e.\n", k, step_str.c_str(), err);
+}
+
+#endif // _SOLVER_MIXED_H_
@@ -0,0 +1,217 @@
+//-*- mode: c++ -*-
+#ifndef _SOLVER_PMINRES_H_
+#define _SOLVER_PMINRES_H_
+
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: pminres(solver_workspace<el_type>& ws, int max_iter, double stop_tol, double shift, bool guess) const {
+	const int n = A.n_rows(), par_min = 10000;
+	ws.resize_aux(n);
+
+	//Zero out solution vector
+	const vector<el_type>& rhs = ws.rhs;
+	vector<el_type>& sol_vec = ws.sol;
+	std::fill(sol_vec.begin(), sol_vec.end(), 0);
+
+	// ---------- set initial values for variables ---------//
+	el_type alpha[2], beta[2]; // the last two entries of the T matrix
+	el_type res[2]; // the last two residuals
+
+	// the last two vectors of the lanczos iteration, and z = B*v for each of them,
+	// where B = M^(-1) A M^(-t) - shift*I. keeping z around means that alpha and
+	// the norm of the next lanczos vector are known without applying B to v.
+	vector<el_type>* v = ws.v;
+	vector<el_type>* z = ws.aux;
+	vector<el_type>& qv = ws.aux[2];
+	std::fill(v[0].begin(), v[0].end(), 0);
+	std::fill(z[0].begin(), z[0].end(), 0);
+
+	double norm_A = 0; // matrix norm estimate
+	double cond_A = 1;	// condition number estimate
+	double c = -1, s = 0; // givens rotation elements
+
+	// temporary variables to store the corner of the matrix we're factoring
+	double gamma_min = 1e99;
+	el_type delta1[2], delta2[2], ep[2], gamma1[2], gamma2[2];
+	delta1[1] = 0;
+
+	// temporary vectors for lanczos calcluations
+	vector<el_type>& pk = ws.q;
+	vector<el_type>& tk = ws.t;
+
+	// step size in the current search direction (xk = x_{k-1} + tau*dk)
+	double tau = 0;
+
+	// the last 3 search directions
+	vector<el_type>* d = ws.w;
+	std::fill(d[0].begin(), d[0].end(), 0);
+	std::fill(d[1].begin(), d[1].end(), 0);
+
+	// out = (M^(-1) A M^(-t) - shift*I) * in, as in minres()
+	auto B = [&](const vector<el_type>& in, vector<el_type>& out) {
+		D.sqrt_solve(in, pk, true);
+		L.forwardsolve(pk, tk);
+		multiply_A(tk, pk);
+		L.backsolve(pk, tk);
+		D.sqrt_solve(tk, out, false);
+		for (int i = 0; i < n; i++) {
+			out[i] -= shift * in[i];
+		}
+	};
+
+	// set up initial values for variables above
+	double eps = A.eps;
+	// with an initial guess, we solve for the correction to it, as in minres()
+	const vector<el_type>& r0 = (guess ? ws.r : rhs);
+	beta[0] = 0;
+	beta[1] = norm(r0, 2.0);
+
+	double norm_rhs = norm(rhs, 2.0);
+	if (norm_rhs == 0 || beta[1] == 0) return;
+
+	// v[1] = r0/beta[1], z[1] = B*v[1]
+	for (int i = 0; i < n; i++) {
+		v[1][i] = r0[i]/beta[1];
+	}
+	B(v[1], z[1]);
+
+	// the one reduction of each iteration gives a = v'*z (the next alpha), zz = z'*z,
+	// vv = v'*v, and the products pz = vp'*z and pv = vp'*v with the last lanczos
+	// vector vp. together, these give the norm of the next lanczos vector.
+	double a = 0, zz = 0, vv = 0, pz = 0, pv = 0, vv_prev = 0;
+	int i;
+	#pragma omp parallel for reduction(+:a,zz,vv) if(n > par_min)
+	for (i = 0; i < n; i++) {
+		a += v[1][i]*z[1][i];
+		zz += z[1][i]*z[1][i];
+		vv += v[1][i]*v[1][i];
+	}
+
+	res[0] = beta[1];
+	tau = beta[1];
+
+	auto sign = [&](double x) { return (abs(x) < eps ? 0 : x/abs(x)); };
+
+	// -------------- begin minres iterations --------------//
+	int k = 1; // iteration number
+	while (res[(k+1)%2]/norm_rhs > stop_tol && k <= max_iter) {
+		int cur = k%2, nxt = (k+1)%2;
+		// ---------- begin lanczos step ----------//
+		// qv = B*z[cur]. this only starts once the reduction of the last iteration
+		// is done (it is not overlapped with it).
+		B(z[cur], qv);
+
+		alpha[cur] = a;
+		double bprev = (k == 1 ? 0 : beta[cur]);
+
+		// the norm of v[nxt] = z[cur] - alpha*v[cur] - bprev*v[nxt] is known from the
+		// last reduction. the expansion does not assume the lanczos vectors are
+		// orthonormal, as they drift away from this in floating point. if the sum
+		// cancels badly, fall back on computing the norm explicitly.
+		double b2 = zz - a*a*(2 - vv) - 2*bprev*pz + 2*a*bprev*pv + bprev*bprev*vv_prev;
+		if (b2 <= 1e-8*zz) {
+			vector<el_type>& tmp = ws.tmp;
+			for (i = 0; i < n; i++) {
+				tmp[i] = z[cur][i] - a*v[cur][i] - bprev*v[nxt][i];
+			}
+			beta[nxt] = norm(tmp, 2.0);
+		} else {
+			beta[nxt] = sqrt(b2);
+		}
+		// ---------- end lanczos step ----------//
+
+		// left orthogonlization on the middle two entries in the last column of Tk
+		delta2[cur] = c*delta1[cur] + s*alpha[cur];
+		gamma1[cur] = s*delta1[cur] - c*alpha[cur];
+
+		// left orthogonalization to product first two entries of T_{k+1} and ep_{k+1}
+		ep[nxt] = s*beta[nxt];
+		delta1[nxt] = -c*beta[nxt];
+
+		// ---------- begin givens rotation ----------//
+		double ga = gamma1[cur], gb = beta[nxt];
+		if (abs(gb) < eps) {
+			s = 0;
+			gamma2[cur] = abs(ga);
+			if (abs(ga) < eps) {
+				c = 1;
+			} else {
+				c = sign(ga);
+			}
+		} else if (abs(ga) < eps) {
+			c = 0;
+			s = sign(gb);
+			gamma2[cur] = abs(gb);
+		} else if (abs(gb) > abs(ga)) {
+			double t = ga/gb;
+			s = sign(gb)/sqrt(1+t*t);
+			c = s*t;
+			gamma2[cur] = gb/s;
+		} else { //abs(ga) >= abs(gb)
+			double t = gb/ga;
+			c = sign(ga)/sqrt(1+t*t);
+			s = c*t;
+			gamma2[cur] = ga/c;
+		}
+		// ---------- end givens rotation ----------//
+
+		// update residual norms and estimate for matrix norm
+		tau = c*res[nxt];
+		res[cur] = s*res[nxt];
+
+		if (k == 1) norm_A = sqrt(alpha[cur]*alpha[cur] + beta[nxt]*beta[nxt]);
+		else {
+			double tnorm = sqrt(alpha[cur]*alpha[cur] + beta[nxt]*beta[nxt] + beta[cur]*beta[cur]);
+			norm_A = std::max(norm_A, tnorm);
+		}
+
+		bool update = abs(gamma2[cur]) > eps;
+		if (update) {
+			gamma_min = std::min(gamma_min, gamma2[cur]);
+			cond_A = norm_A/gamma_min;
+		}
+
+		// single pass: update the search direction and solution, form the next lanczos
+		// vector and its product with B, and compute the reduction for the next iteration.
+		double scale = (abs(beta[nxt]) > eps ? 1.0/beta[nxt] : 1.0);
+		double g2 = gamma2[cur], e = ep[cur], d2 = delta2[cur];
+		double a1 = 0, zz1 = 0, vv1 = 0, pz1 = 0, pv1 = 0;
+		#pragma omp parallel for reduction(+:a1,zz1,vv1,pz1,pv1) if(n > par_min)
+		for (i = 0; i < n; i++) {
+			if (update) {
+				// d[cur] = (v[cur] - delta2[cur]*d[nxt] - ep[cur]*d[cur])/gamma2[cur]
+				d[cur][i] = (v[cur][i] - e*d[cur][i] - d2*d[nxt][i])/g2;
+				sol_vec[i] += tau*d[cur][i];
+			}
+
+			el_type vn = (z[cur][i] - a*v[cur][i] - bprev*v[nxt][i])*scale;
+			el_type zn = (qv[i] - a*z[cur][i] - bprev*z[nxt][i])*scale;
+			v[nxt][i] = vn;
+			z[nxt][i] = zn;
+
+			a1 += vn*zn;
+			zz1 += zn*zn;
+			vv1 += vn*vn;
+			pz1 += v[cur][i]*zn;
+			pv1 += v[cur][i]*vn;
+		}
+		a = a1; zz = zz1; vv_prev = vv; vv = vv1; pz = pz1; pv = pv1;
+
+		k++;
+
+		// ------------- end update ------------- //
+	}
+
+	if (msg_lvl) printf("The estimated condition number of the matrix is %e.\n", cond_A);
+
+    std::string iter_str = "iterations";
+    if (k-1 == 1) iter_str = "iteration";
+
+	if (msg_lvl) printf("Pipelined MINRES took %i %s and got down to relative residual %e.\n", k-1, iter_str.c_str(), res[(k+1)%2]/norm_rhs);
+	return;
+}
+
+#endif // _SOLVER_PMINRES_H_
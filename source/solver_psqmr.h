@@ -0,0 +1,173 @@
+//-*- mode: c++ -*-
+#ifndef _SOLVER_PSQMR_H_
+#define _SOLVER_PSQMR_H_
+
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: psqmr(solver_workspace<el_type>& ws, int max_iter, double stop_tol, int check_every, bool guess) const {
+	const int n = A.n_rows(), par_min = 10000;
+	ws.resize_aux(n);
+	if (check_every < 1) check_every = 1;
+
+	// ---------- set initial values for variables ---------//
+
+	// the vectors of sqmr(): the iterate, residual, preconditioned residual (t in
+	// sqmr()), search direction (q in sqmr()), and the update to the iterate.
+	const vector<el_type>& rhs = ws.rhs;
+	vector<el_type>& sol_vec = ws.sol;
+	vector<el_type>& x = ws.x;
+	vector<el_type>& r = ws.r;
+	vector<el_type>& u = ws.t;
+	vector<el_type>& p = ws.q;
+	vector<el_type>& d = ws.d;
+	vector<el_type>& tmp = ws.tmp;
+
+	// auxiliary vectors, so that every operator is applied to a vector that is
+	// known before the reduction of the current iteration is finished:
+	// w = A*u, m = M^(-1)*w, nv = A*m, s = A*p, q = M^(-1)*s, z = A*q.
+	vector<el_type>& w = ws.aux[0];
+	vector<el_type>& m = ws.aux[1];
+	vector<el_type>& nv = ws.aux[2];
+	vector<el_type>& s = ws.aux[3];
+	vector<el_type>& q = ws.aux[4];
+	vector<el_type>& z = ws.aux[5];
+
+	if (guess) {
+		x = sol_vec;
+	} else {
+		std::fill(sol_vec.begin(), sol_vec.end(), 0);
+		std::fill(x.begin(), x.end(), 0);
+	}
+	std::fill(d.begin(), d.end(), 0);
+	std::fill(p.begin(), p.end(), 0);
+	std::fill(s.begin(), s.end(), 0);
+	std::fill(q.begin(), q.end(), 0);
+	std::fill(z.begin(), z.end(), 0);
+
+	// Our preconditioner M = LDL'.
+	auto Minv = [&](const vector<el_type>& in, vector<el_type>& out) {
+		L.backsolve(in, out);
+		D.solve(out, tmp);
+		L.forwardsolve(tmp, out);
+	};
+
+	// residual = b - A*x0, u = M^(-1)*r, w = A*u
+	if (guess) {
+		multiply_A(x, r);
+		vector_sum(1, rhs, -1, r, r);
+	} else {
+		r = rhs;
+	}
+	Minv(r, u);
+	multiply_A(u, w);
+
+	// the one reduction of each iteration: gam = r'*u, del = w'*u, nu = u'*u, rr = r'*r
+	double gam = 0, del = 0, nu = 0, rr = 0;
+	int i;
+	#pragma omp parallel for reduction(+:gam,del,nu,rr) if(n > par_min)
+	for (i = 0; i < n; i++) {
+		gam += r[i]*u[i];
+		del += w[i]*u[i];
+		nu += u[i]*u[i];
+		rr += r[i]*r[i];
+	}
+
+	double norm_rhs = (guess ? norm(rhs, 2.0) : sqrt(rr));
+	if (norm_rhs == 0) {
+		std::fill(sol_vec.begin(), sol_vec.end(), 0);
+		return;
+	}
+
+	double res = sqrt(rr);
+	double resmin = res;
+
+	double tau = sqrt(nu), thet = 0;
+	double alpha = 0, alpha1, gam1 = 0, beta, thet1, c2;
+
+	// the update of x for iteration k is only known once the reduction of iteration k
+	// is done, so it is applied in the first pass of iteration k+1 (d = cd*d + ca*p).
+	double cd = 0, ca = 0;
+	bool save_best = false;
+
+	// -------------- begin sqmr iterations --------------//
+	int k = 1; // iteration number
+	while (k <= max_iter) {
+		// m = M^(-1)*w, nv = A*m. these only start once the reduction of the last
+		// iteration is done (they are not overlapped with it).
+		Minv(w, m);
+		multiply_A(m, nv);
+
+		if (k == 1) {
+			beta = 0;
+			alpha = gam/del;
+		} else {
+			beta = gam/gam1;
+			alpha = gam/(del - beta*gam/alpha1);
+		}
+
+		// single pass: finish the update of x from the last iteration, then update all
+		// recurrences for this iteration and compute the reduction for the next one.
+		double g = 0, dl = 0, nu1 = 0, rr1 = 0;
+		#pragma omp parallel for reduction(+:g,dl,nu1,rr1) if(n > par_min)
+		for (i = 0; i < n; i++) {
+			d[i] = cd*d[i] + ca*p[i];
+			x[i] += d[i];
+			if (save_best) sol_vec[i] = x[i];
+
+			p[i] = u[i] + beta*p[i];
+			s[i] = w[i] + beta*s[i];
+			q[i] = m[i] + beta*q[i];
+			z[i] = nv[i] + beta*z[i];
+
+			r[i] -= alpha*s[i];
+			u[i] -= alpha*q[i];
+			w[i] -= alpha*z[i];
+
+			g += r[i]*u[i];
+			dl += w[i]*u[i];
+			nu1 += u[i]*u[i];
+			rr1 += r[i]*r[i];
+		}
+		gam1 = gam; gam = g; del = dl; nu = nu1; rr = rr1;
+		alpha1 = alpha;
+
+		// quasi-minimization of this iteration (applied to x in the next pass)
+		thet1 = thet;
+		thet = sqrt(nu)/tau;
+		c2 = 1.0/(1 + thet*thet);
+		tau = tau * thet * sqrt(c2);
+		cd = c2 * thet1 * thet1;
+		ca = c2 * alpha;
+
+		k++;
+		// ------------- end update ------------- //
+
+		save_best = false;
+		if ((k-1) % check_every == 0 || k > max_iter) {
+			res = sqrt(rr);
+			if (res < resmin) {
+				resmin = res;
+				save_best = true;
+			}
+			if (res/norm_rhs <= stop_tol) break;
+		}
+	}
+
+	// apply the last update of x
+	for (i = 0; i < n; i++) {
+		d[i] = cd*d[i] + ca*p[i];
+		x[i] += d[i];
+		if (save_best) sol_vec[i] = x[i];
+	}
+
+    std::string iter_str = "iterations";
+    if (k-1 == 1) iter_str = "iteration";
+
+	if (msg_lvl) printf("Pipelined SQMR took %i %s and got down to relative residual %e.\n", k-1, iter_str.c_str(), resmin/norm_rhs);
+	return;
+}
+
+#endif // _SOLVER_PSQMR_H_
@@ -0,0 +1,258 @@
+//-*- mode: c++ -*-
+#ifndef _SOLVER_RECYCLE_H_
+#define _SOLVER_RECYCLE_H_
+
+#include <algorithm>
+#include <cmath>
+
+namespace dense {
+	/*! \brief Computes the eigendecomposition A = QVQ' of a small dense symmetric matrix with the cyclic Jacobi method.
+		\param n the dimension of A.
+		\param a the matrix A (stored column major). It is overwritten.
+		\param eig a storage vector for the eigenvalues.
+		\param q a storage vector for the eigenvectors (stored column major).
+	*/
+	inline void sym_eig(int n, vector<double>& a, vector<double>& eig, vector<double>& q)
+	{
+		int i, j, k;
+		q.assign(n*n, 0);
+		for (i = 0; i < n; i++) q[i + i*n] = 1;
+
+		double total = 0;
+		for (i = 0; i < n*n; i++) total += a[i]*a[i];
+
+		for (int sweep = 0; sweep < 100; sweep++) {
+			double off = 0;
+			for (j = 0; j < n; j++) {
+				for (i = 0; i < j; i++) off += a[i + j*n]*a[i + j*n];
+			}
+			if (off <= 1e-30 * total) break;
+
+			for (int p = 0; p < n; p++) {
+				for (int r = p+1; r < n; r++) {
+					double apr = a[p + r*n];
+					if (apr == 0) continue;
+
+					//rotation that zeroes A(p, r), as in "Numerical Recipes" (jacobi)
+					double theta = (a[r + r*n] - a[p + p*n])/(2*apr);
+					double t = (theta >= 0 ? 1.0 : -1.0)/(abs(theta) + sqrt(theta*theta + 1));
+					double c = 1/sqrt(t*t + 1), s = t*c;
+
+					for (k = 0; k < n; k++) {
+						double akp = a[k + p*n], akr = a[k + r*n];
+						a[k + p*n] = c*akp - s*akr;
+						a[k + r*n] = s*akp + c*akr;
+					}
+					for (k = 0; k < n; k++) {
+						double apk = a[p + k*n], ark = a[r + k*n];
+						a[p + k*n] = c*apk - s*ark;
+						a[r + k*n] = s*apk + c*ark;
+					}
+					for (k = 0; k < n; k++) {
+						double qkp = q[k + p*n], qkr = q[k + r*n];
+						q[k + p*n] = c*qkp - s*qkr;
+						q[k + r*n] = s*qkp + c*qkr;
+					}
+				}
+			}
+		}
+
+		eig.resize(n);
+		for (i = 0; i < n; i++) eig[i] = a[i + i*n];
+	}
+
+	/*! \brief Functor for ordering eigenvalues by magnitude (in increasing order).
+		\param v the vector that contains the eigenvalues being compared.
+	*/
+	struct by_magnitude {
+		const vector<double>& v;
+		by_magnitude(const vector<double>& vec) : v(vec) {}
+		bool operator()(int const &a, int const &b) const {
+			return abs(v[a]) < abs(v[b]);
+		}
+	};
+}
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: deflate(const solver_workspace<el_type>& ws, vector<el_type>& y) const {
+	// y = y - W*E^(-1)*U'*y
+	for (int j = 0; j < (int) ws.U.size(); j++) {
+		double h = dot_product(ws.U[j], y)/ws.E[j];
+		vector_sum(1, y, -h, ws.W[j], y);
+	}
+}
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: undeflate(solver_workspace<el_type>& ws, const vector<el_type>& r0, vector<el_type>& z) const {
+	// z = U*E^(-1)*U'*r0 + (I - U*E^(-1)*W')*z
+	const int nu = ws.U.size();
+	vector<double>& h = ws.ritz[3];
+	h.resize(nu);
+	for (int j = 0; j < nu; j++) {
+		h[j] = (dot_product(ws.U[j], r0) - dot_product(ws.W[j], z))/ws.E[j];
+	}
+	for (int j = 0; j < nu; j++) {
+		vector_sum(1, z, h[j], ws.U[j], z);
+	}
+}
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: recycle_space(solver_workspace<el_type>& ws, int p, double shift) const {
+	const int k = ws.U.size(), m = k + p, n = A.n_rows();
+	int i, j, l;
+
+	// the candidate space is [U, Z(:, 1:p)], and B times it is [W, BZ(:, 1:p)]
+	auto z = [&](int l) -> const vector<el_type>& { return (l < k ? ws.U[l] : ws.Z[l-k]); };
+	auto bz = [&](int l) -> const vector<el_type>& { return (l < k ? ws.W[l] : ws.BZ[l-k]); };
+
+	// Rayleigh-Ritz on the candidate space: G = Z'*B*Z = S*diag(lambda)*S'
+	vector<double>& G = ws.ritz[0], & lambda = ws.ritz[1], & S = ws.ritz[2];
+	G.resize(m*m);
+	for (j = 0; j < m; j++) {
+		for (i = 0; i <= j; i++) {
+			G[i + j*m] = G[j + i*m] = 0.5*(dot_product(z(i), bz(j)) + dot_product(z(j), bz(i)));
+		}
+	}
+	dense::sym_eig(m, G, lambda, S);
+
+	// keep the Ritz vectors of the smallest Ritz values (in magnitude), except
+	// those of (numerically) zero Ritz values, which would make E singular.
+	double lmax = 0;
+	for (i = 0; i < m; i++) lmax = std::max(lmax, (double) abs(lambda[i]));
+
+	vector<int>& order = ws.ritz_order;
+	order.clear();
+	for (i = 0; i < m; i++) {
+		if (abs(lambda[i]) > 1e-12*lmax) order.push_back(i);
+	}
+	std::sort(order.begin(), order.end(), dense::by_magnitude(lambda));
+	if ((int) order.size() > recycle_dim) order.resize(recycle_dim);
+
+	// U = Z*S, W = B*Z*S and E = U'*B*U = diag(lambda). each row of U and W only
+	// depends on the same row of Z and B*Z, so U and W are overwritten in place, a
+	// row at a time.
+	const int kn = order.size();
+	if (kn > k) {
+		ws.U.resize(kn, vector<el_type>(n));
+		ws.W.resize(kn, vector<el_type>(n));
+	}
+	vector<double>& row = ws.ritz[3];
+	row.resize(2*m);
+	for (i = 0; i < n; i++) {
+		for (l = 0; l < m; l++) {
+			row[l] = z(l)[i];
+			row[m+l] = bz(l)[i];
+		}
+		for (j = 0; j < kn; j++) {
+			const double* s = &S[order[j]*m];
+			double u = 0, w = 0;
+			for (l = 0; l < m; l++) {
+				u += s[l]*row[l];
+				w += s[l]*row[m+l];
+			}
+			ws.U[j][i] = u;
+			ws.W[j][i] = w;
+		}
+	}
+	ws.U.resize(kn);
+	ws.W.resize(kn);
+	ws.E.resize(kn);
+	for (j = 0; j < kn; j++) ws.E[j] = lambda[order[j]];
+
+	ws.recycle_id = factor_id;
+	ws.recycle_shift = shift;
+}
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: recycle_refresh(solver_workspace<el_type>& ws, double shift) const {
+	// a subspace found with another factorization does not belong to the current
+	// preconditioned matrix (and need not even be of the right size), so it is dropped.
+	if (ws.recycle_id != factor_id) {
+		ws.clear_recycle();
+		ws.recycle_id = factor_id;
+		ws.recycle_shift = shift;
+		return;
+	}
+	if (ws.U.empty() || ws.recycle_shift == shift) return;
+
+	// a new shift only moves B by a multiple of I, so W = B*U and the Ritz values E
+	// move by the same multiple of U and 1. U is dropped if that makes E singular.
+	const double ds = shift - ws.recycle_shift;
+	double emax = 0;
+	for (int j = 0; j < (int) ws.U.size(); j++) {
+		vector_sum(1, ws.W[j], -ds, ws.U[j], ws.W[j]);
+		ws.E[j] -= ds;
+		emax = std::max(emax, (double) abs(ws.E[j]));
+	}
+	for (int j = 0; j < (int) ws.U.size(); j++) {
+		if (abs(ws.E[j]) <= 1e-12*emax) {
+			ws.clear_recycle();
+			break;
+		}
+	}
+	ws.recycle_shift = shift;
+}
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: recycle_update(solver_workspace<el_type>& ws, int m, double shift) const {
+	if (m <= 0) return;
+	const int k = ws.U.size();
+	int i, j;
+
+	// Ritz pairs of the tridiagonal lanczos matrix of the last solve
+	vector<double>& T = ws.ritz[0], & theta = ws.ritz[1], & Y = ws.ritz[2];
+	T.assign(m*m, 0);
+	for (i = 0; i < m; i++) {
+		T[i + i*m] = ws.lan_alpha[i];
+		if (i+1 < m) T[i+1 + i*m] = T[i + (i+1)*m] = ws.lan_beta[i];
+	}
+	dense::sym_eig(m, T, theta, Y);
+
+	vector<int>& order = ws.ritz_order;
+	order.resize(m);
+	for (i = 0; i < m; i++) order[i] = i;
+	std::sort(order.begin(), order.end(), dense::by_magnitude(theta));
+	if (m > recycle_dim) order.resize(recycle_dim);
+
+	// the new directions q = V*y, for the Ritz pairs (theta, y) kept. the solve ran
+	// with the deflated matrix B - W*E^(-1)*W', so its lanczos relation gives
+	//   B*V = V*T + beta_m*v_{m+1}*e_m' + W*E^(-1)*W'*V,
+	// and B*q = theta*q + beta_m*y_m*v_{m+1} + W*E^(-1)*W'*q without applying B.
+	// q is then orthonormalised against U and the directions before it (twice, by
+	// classical Gram-Schmidt), with the same combinations taken of B*q.
+	int p = 0;
+	for (j = 0; j < (int) order.size(); j++) {
+		vector<el_type>& q = ws.Z[p], & bq = ws.BZ[p];
+		const double* y = &Y[order[j]*m];
+		std::fill(q.begin(), q.end(), 0);
+		for (i = 0; i < m; i++) {
+			vector_sum(1, q, y[i], ws.V[i], q);
+		}
+		vector_sum(theta[order[j]], q, ws.lan_beta[m-1]*y[m-1], ws.V[m], bq);
+		for (i = 0; i < k; i++) {
+			vector_sum(1, bq, dot_product(ws.W[i], q)/ws.E[i], ws.W[i], bq);
+		}
+
+		double nq = norm(q, 2.0);
+		for (int pass = 0; pass < 2; pass++) {
+			for (i = 0; i < k + p; i++) {
+				const vector<el_type>& zi = (i < k ? ws.U[i] : ws.Z[i-k]);
+				double h = dot_product(zi, q);
+				vector_sum(1, q, -h, zi, q);
+				vector_sum(1, bq, -h, (i < k ? ws.W[i] : ws.BZ[i-k]), bq);
+			}
+		}
+
+		double nq1 = norm(q, 2.0);
+		if (nq1 <= 1e-8*nq) continue; // already in the candidate space
+		for (i = 0; i < (int) q.size(); i++) {
+			q[i] /= nq1;
+			bq[i] /= nq1;
+		}
+		p++;
+	}
+
+	recycle_space(ws, p, shift);
+}
+
+#endif // _SOLVER_RECYCLE_H_
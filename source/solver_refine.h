@@ -0,0 +1,51 @@
+//-*- mode: c++ -*-
+#ifndef _SOLVER_REFINE_H_
+#define _SOLVER_REFINE_H_
+
+template<class el_type, class mat_type >
+void solver<el_type, mat_type> :: refine(solver_workspace<el_type>& ws, int max_steps) const {
+	int n = A.n_rows();
+	ws.resize(n);
+
+	const vector<el_type>& rhs = ws.rhs;
+	vector<el_type>& sol_vec = ws.sol;
+	vector<el_type>& r = ws.r;
+	vector<el_type>& dx = ws.d;
+	vector<el_type>& tmp = ws.tmp;
+
+	double norm_rhs = norm(rhs, 2.0);
+	if (norm_rhs == 0) return;
+
+	// r = b - A*x
+	multiply_A(sol_vec, r);
+	vector_sum(1, rhs, -1, r, r);
+	double res = norm(r, 2.0), res0 = res;
+
+	int k = 0;
+	while (k < max_steps) {
+		// dx = (LDL')^(-1) * r
+		L.backsolve(r, dx);
+		D.solve(dx, tmp);
+		L.forwardsolve(tmp, dx);
+
+		vector_sum(1, sol_vec, 1, dx, tmp);
+
+		multiply_A(tmp, r);
+		vector_sum(1, rhs, -1, r, r);
+		double res1 = norm(r, 2.0);
+
+		// stop as soon as the correction no longer helps
+		if (res1 >= res) break;
+
+		sol_vec.swap(tmp);
+		res = res1;
+		k++;
+	}
+
+	std::string step_str = "steps";
+	if (k == 1) step_str = "step";
+
+	if (msg_lvl) printf("Iterative refinement took %i %s and reduced the relative residual from %e to %e.\n", k, step_str.c_str(), res0/norm_rhs, res/norm_rhs);
+}
+
+#endif // _SOLVER_REFINE_H_
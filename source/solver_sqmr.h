@@ -7,27 +7,49 @@
 #include <cmath>
 
 template<class el_type, class mat_type >
-void solver<el_type, mat_type> :: sqmr(int max_iter, double stop_tol) {
-	//Zero out solution vector
-	int n = A.n_rows();
-	sol_vec.resize(n, 0);
+void solver<el_type, mat_type> :: sqmr(solver_workspace<el_type>& ws, int max_iter, double stop_tol, int check_every, bool guess) const {
+	const int n = A.n_rows(), par_min = 10000;
+	ws.resize(n);
+	if (check_every < 1) check_every = 1;
 	
-	// ---------- set initial values and allocate memory for variables ---------//	
+	// ---------- set initial values for variables ---------//	
 	
-	// temporary vectors for calcluations
-	vector<el_type> x(n), q(n), t(n), r(n), tmp(n);
-	
-	// residual = b - A*x0
-	r = rhs;
+	// temporary vectors for calcluations (all taken from the workspace)
+	const vector<el_type>& rhs = ws.rhs;
+	vector<el_type>& q = ws.q;
+	vector<el_type>& t = ws.t;
+	vector<el_type>& r = ws.r;
+	vector<el_type>& tmp = ws.tmp;
 	
 	// search direction
-	vector<el_type> d(n);
+	vector<el_type>& d = ws.d;
+	
+	// the iterate lives in one of two buffers. the best iterate so far is never
+	// overwritten: the next iterate is written into the other buffer instead (which
+	// costs no more than an inplace update), so the best iterate is never copied.
+	vector<el_type>* xb[2] = {&ws.sol, &ws.x};
+	int cur = 0, best = 0;
 	
 	// set up initial values for variables above
-	double eps = A.eps;
 	double norm_rhs = norm(rhs, 2.0);
+	if (norm_rhs == 0) guess = false;
+	
+	// zero out solution vector (unless it holds the initial guess) and iterate
+	if (!guess) std::fill(ws.sol.begin(), ws.sol.end(), 0);
+	std::fill(ws.x.begin(), ws.x.end(), 0);
+	std::fill(d.begin(), d.end(), 0);
 
-	double res = norm_rhs;
+	if (norm_rhs == 0) return;
+	
+	// residual = b - A*x0
+	if (guess) {
+		multiply_A(ws.sol, r);
+		vector_sum(1, rhs, -1, r, r);
+	} else {
+		r = rhs;
+	}
+
+	double res = norm(r, 2.0);
 	double resmin = res;
 	
 	// Our preconditioner M = LDL'.
@@ -46,64 +68,80 @@ void solver<el_type, mat_type> :: sqmr(int max_iter, double stop_tol) {
 	double rho = dot_product(r, q);
 	
 	double sigma, alpha, thet1, c2, rho1, beta;
+	int i;
 
 	// -------------- begin sqmr iterations --------------//
 	int k = 1; // iteration number
 	while (res/norm_rhs > stop_tol && k <= max_iter) {		
 		// t = A * q
 		// sigma = q'*t
-		A.multiply(q, t);
+		multiply_A(q, t);
 		sigma = dot_product(q, t);
 		alpha = rho/sigma;
 		
 		// r = r - alpha * t
-		vector_sum(1, r, -alpha, t, r);
+		#pragma omp parallel for if(n > par_min)
+		for (i = 0; i < n; i++) {
+			r[i] -= alpha*t[i];
+		}
 		
 		// t = Minv(r)
 		Minv(r, t);
 		
+		// one pass for all inner products: tt = t'*t, rt = r'*t and rr = r'*r
+		double tt = 0, rt = 0, rr = 0;
+		#pragma omp parallel for reduction(+:tt,rt,rr) if(n > par_min)
+		for (i = 0; i < n; i++) {
+			tt += t[i]*t[i];
+			rt += r[i]*t[i];
+			rr += r[i]*r[i];
+		}
+		
 		thet1 = thet;
-		thet = norm(t, 2.0)/tau;
+		thet = sqrt(tt)/tau;
 		
 		c2 = 1.0/(1 + thet*thet);
 		
 		tau = tau * thet * sqrt(c2);
-		if (k == 1) {
-			// d = c^2 * alpha * q
-			for (int i = 0; i < n; i++) {
-				d[i] = c2 * alpha * q[i];
-			}
-		} else {
-			// d = c^2 * thet1^2 * d + c^2 * alpha * q
-			vector_sum(c2 * thet1 * thet1, d, c2 * alpha, q, d);
-		}
-		
-		// update x
-		vector_sum(1, x, 1, d, x);
 		
-		// update residual and norms
-		res = norm(r, 2.0);
-		/*
-		// the true residual
-		A.multiply(x, tmp);
-		vector_sum(1, rhs, -1, tmp, tmp);
-		res = norm(tmp, 2.0);
-		*/
+		rho1 = rho;
+		rho = rt;
+		beta = rho/rho1;
 		
-		if (res < resmin) {
-			resmin = res;
-			sol_vec = x;
+		// update residual norm (only every check_every iterations, and on the last one)
+		bool improved = false;
+		if (k % check_every == 0 || k == max_iter) {
+			res = sqrt(rr);
+			if (res < resmin) {
+				resmin = res;
+				improved = true;
+			}
 		}
 		
-		rho1 = rho;
-		rho = dot_product(r, t);
-		beta = rho/rho1;
-		vector_sum(1, t, beta, q, q);
+		// one pass for all vector updates:
+		// d = c^2 * thet1^2 * d + c^2 * alpha * q (d is zero in the first iteration)
+		// x = x + d
+		// q = t + beta * q
+		int nxt = (cur == best ? 1-cur : cur);
+		const vector<el_type>& x = *xb[cur];
+		vector<el_type>& xn = *xb[nxt];
+		const double cd = c2 * thet1 * thet1, ca = c2 * alpha;
+		#pragma omp parallel for if(n > par_min)
+		for (i = 0; i < n; i++) {
+			d[i] = cd*d[i] + ca*q[i];
+			xn[i] = x[i] + d[i];
+			q[i] = t[i] + beta*q[i];
+		}
+		cur = nxt;
+		if (improved) best = cur;
 		
 		k++;
 		// ------------- end update ------------- //
 	}
 	
+	// the solution is the best iterate
+	if (best == 1) ws.sol.swap(ws.x);
+	
     std::string iter_str = "iterations";
     if (k-1 == 1) iter_str = "iteration";
 
@@ -0,0 +1,129 @@
+// -*- mode: c++ -*-
+#ifndef _SOLVER_WORKSPACE_H_
+#define _SOLVER_WORKSPACE_H_
+
+/*!	\brief A structure containing all temporary vectors used when solving with a factorization.
+
+	The vectors are allocated on the first solve (or by resize()), and reused by every later solve of the same size, so that repeated solves against one factorization do no heap allocation.
+*/
+template<class el_type>
+class solver_workspace
+{
+	typedef vector<el_type> elt_vector_type;
+
+	public:
+		elt_vector_type rhs;	///<The permuted and equilibrated right hand side, i.e. P'S*b.
+		elt_vector_type sol;	///<The solution of the permuted and equilibrated system.
+
+		elt_vector_type x;	///<The current iterate (SQMR).
+		elt_vector_type r;	///<The residual (SQMR and iterative refinement).
+		elt_vector_type q;	///<The search direction (SQMR) or the current Lanczos product (MINRES).
+		elt_vector_type t;	///<The preconditioned residual (SQMR) or a temporary for the Lanczos product (MINRES).
+		elt_vector_type d;	///<The update to the iterate (SQMR and iterative refinement) or the deflated initial residual (MINRES with recycling).
+		elt_vector_type tmp;	///<General temporary storage.
+
+		elt_vector_type v[2];	///<The last two Lanczos vectors (MINRES).
+		elt_vector_type w[2];	///<The last two search directions (MINRES).
+		std::vector<float> lo[2];	///<Single precision vectors used by the mixed precision solve (only allocated by it).
+		elt_vector_type aux[6];	///<Auxiliary vectors of the pipelined solvers (only allocated by resize_aux()).
+		
+		std::vector<elt_vector_type> basis;	///<The krylov basis of GMRES (only allocated by resize_gmres()).
+		std::vector<elt_vector_type> zbasis;	///<The preconditioned krylov basis of FGMRES.
+		std::vector<double> hess;	///<The hessenberg matrix of GMRES.
+		std::vector<double> givens;	///<The givens rotations, rotated right hand side and inner products of GMRES.
+		
+		std::vector<elt_vector_type> U;	///<An orthonormal basis of the subspace recycled by MINRES between solves (approximate eigenvectors of the preconditioned matrix B).
+		std::vector<elt_vector_type> W;	///<The products B*U.
+		std::vector<double> E;	///<The (diagonal) matrix U'*B*U.
+		long long recycle_id;	///<The factorization U was found with (see solver::factor_id).
+		double recycle_shift;	///<The shift U was found with.
+		std::vector<elt_vector_type> Z;	///<The new directions U is updated with after a solve (only allocated by resize_recycle()).
+		std::vector<elt_vector_type> BZ;	///<The products B*Z.
+		std::vector<double> ritz[4];	///<The small dense matrices and vectors of the Ritz problems solved when U is updated.
+		std::vector<int> ritz_order;	///<The Ritz values kept when U is updated.
+		
+		elt_vector_type sparse_x;	///<The dense image of the solution of a sparse solve, which is all zero between solves (only allocated by resize_sparse()).
+		std::vector<int> sparse_b;	///<The nonzero pattern of the right hand side (and solution) of a sparse solve.
+		std::vector<int> sparse_idx;	///<The nonzero pattern of the intermediate solutions of a sparse solve.
+		std::vector<int> sparse_stack;	///<The depth first search stack of a sparse solve.
+		std::vector<bool> sparse_mark;	///<The visited nodes of the depth first search of a sparse solve (all false between solves).
+		
+		std::vector<elt_vector_type> V;	///<The first lanczos vectors of the last MINRES solve (and the one after them), from which U is updated.
+		std::vector<double> lan_alpha;	///<The diagonal of the lanczos tridiagonal matrix of the last MINRES solve.
+		std::vector<double> lan_beta;	///<The off-diagonal of the lanczos tridiagonal matrix of the last MINRES solve.
+		
+		solver_workspace() : recycle_id(-1), recycle_shift(0) {}
+		
+		/*!	\brief Allocates the krylov basis and small matrices used by GMRES(m) (or FGMRES(m), if flexible is true) for systems of dimension n. Does nothing if they already have this size.
+		*/
+		void resize_gmres(int n, int m, bool flexible) {
+			resize(n);
+			if ((int) basis.size() != m+1 || (int) basis[0].size() != n) {
+				basis.assign(m+1, elt_vector_type(n, 0));
+				hess.assign((m+1)*m, 0);
+				givens.assign(4*m+2, 0);
+			}
+			if (flexible && ((int) zbasis.size() != m || (int) zbasis[0].size() != n)) {
+				zbasis.assign(m, elt_vector_type(n, 0));
+			}
+		}
+		
+		/*!	\brief Allocates the vectors used by sparse solves for systems of dimension n. Does nothing if they already have this size.
+		*/
+		void resize_sparse(int n) {
+			if ((int) sparse_x.size() == n) return;
+			sparse_x.assign(n, 0);
+			sparse_mark.assign(n, false);
+			sparse_stack.assign(2*n, 0);
+			sparse_b.reserve(n); sparse_idx.reserve(n);
+		}
+		
+		/*!	\brief Allocates the vectors used by MINRES with a recycled subspace of dimension dim for systems of dimension n, keeping up to store lanczos vectors. Does nothing if they already have this size.
+		*/
+		void resize_recycle(int n, int dim, int store) {
+			resize(n);
+			if ((int) Z.size() != dim || (int) Z[0].size() != n) {
+				Z.assign(dim, elt_vector_type(n, 0));
+				BZ.assign(dim, elt_vector_type(n, 0));
+			}
+			if ((int) V.size() != store+1 || (int) V[0].size() != n) {
+				V.assign(store+1, elt_vector_type(n, 0));
+				lan_alpha.assign(store, 0);
+				lan_beta.assign(store, 0);
+			}
+		}
+		
+		/*!	\brief Discards the recycled subspace.
+		*/
+		void clear_recycle() {
+			U.clear(); W.clear(); E.clear();
+		}
+
+		/*!	\brief Allocates space for systems of dimension n, discarding the recycled subspace if n changes. Does nothing if the workspace already has this size.
+		*/
+		void resize(int n) {
+			if ((int) rhs.size() == n) return;
+
+			clear_recycle();
+			rhs.assign(n, 0); sol.assign(n, 0);
+			x.assign(n, 0); r.assign(n, 0); q.assign(n, 0);
+			t.assign(n, 0); d.assign(n, 0); tmp.assign(n, 0);
+			for (int i = 0; i < 2; i++) {
+				v[i].assign(n, 0);
+				w[i].assign(n, 0);
+			}
+		}
+
+		/*!	\brief Allocates the auxiliary vectors used by the pipelined solvers for systems of dimension n. Does nothing if they already have this size.
+		*/
+		void resize_aux(int n) {
+			resize(n);
+			if ((int) aux[0].size() == n) return;
+
+			for (int i = 0; i < 6; i++) {
+				aux[i].assign(n, 0);
+			}
+		}
+};
+
+#endif
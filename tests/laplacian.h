@@ -0,0 +1,20 @@
+// Test matrices shared by the regression tests.
+#ifndef _TEST_LAPLACIAN_H_
+#define _TEST_LAPLACIAN_H_
+
+// the 7 point Laplacian on an m*m*m grid, shifted to make it indefinite (lower half, CSC)
+static void laplacian(int m, double shift, vector<int>& ptr, vector<int>& row, vector<double>& val) {
+	const int n = m*m*m;
+	ptr.assign(1, 0);
+	row.clear(); val.clear();
+	for (int j = 0; j < n; j++) {
+		const int x = j % m, y = (j/m) % m, z = j/(m*m);
+		row.push_back(j); val.push_back(6.0 - shift);
+		if (x+1 < m) { row.push_back(j+1); val.push_back(-1.0); }
+		if (y+1 < m) { row.push_back(j+m); val.push_back(-1.0); }
+		if (z+1 < m) { row.push_back(j+m*m); val.push_back(-1.0); }
+		ptr.push_back(row.size());
+	}
+}
+
+#endif
@@ -0,0 +1,38 @@
+// Checks that the factorization keeps to its memory budget.
+#include "solver.h"
+
+#include <cstdio>
+
+// the peak storage of the factors of bratu3d within budget megabytes
+static size_t factor_peak(double budget, const char* ooc_file = "") {
+	symildl::solver<double> solv;
+	solv.set_message_level("none");
+	solv.load("test_matrices/bratu3d.mtx");
+	solv.set_memory_budget((size_t) (budget*1048576));
+	solv.set_out_of_core(ooc_file, 1 << 16);
+	solv.factor(10.0, 1e-4, 1.0);
+	return solv.A.peak_bytes;
+}
+
+int main() {
+	int failures = 0;
+
+	// bratu3d has many 2x2 pivots, which used to take the factors a little over
+	const double budgets[] = {5.0, 6.0, 8.0};
+	for (double budget : budgets) {
+		const size_t peak = factor_peak(budget), peak_ooc = factor_peak(budget, "test_mem_budget.bin");
+		if (peak > budget*1048576 || peak_ooc > budget*1048576) {
+			printf("a budget of %.1f MB peaked at %.3f MB (%.3f MB out of core)\n", budget, peak/1048576.0, peak_ooc/1048576.0);
+			failures++;
+		}
+	}
+
+	// a budget smaller than the fixed part of the factors cannot be kept
+	if (factor_peak(1.0) <= 1048576) {
+		printf("a budget of 1 MB was kept\n");
+		failures++;
+	}
+
+	printf("test_mem_budget: %s\n", (failures ? "FAILED" : "passed"));
+	return (failures ? 1 : 0);
+}
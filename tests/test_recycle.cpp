@@ -0,0 +1,102 @@
+// Checks MINRES with a recycled subspace: it solves, it reuses its workspace, it
+// survives a refactorization with a matrix of another size, and a workspace can be
+// shared by two solvers.
+#include "solver.h"
+#include "laplacian.h"
+
+#include <cstdio>
+#include <cmath>
+
+// ||b - A*x||/||b|| for A given by its lower half in CSC format
+static double residual(const vector<int>& ptr, const vector<int>& row, const vector<double>& val, const vector<double>& b, const vector<double>& x) {
+	vector<double> r(b);
+	for (int j = 0; j + 1 < (int) ptr.size(); j++) {
+		for (int k = ptr[j]; k < ptr[j+1]; k++) {
+			r[row[k]] -= val[k]*x[j];
+			if (row[k] != j) r[j] -= val[k]*x[row[k]];
+		}
+	}
+	double nr = 0, nb = 0;
+	for (int i = 0; i < (int) b.size(); i++) {
+		nr += r[i]*r[i];
+		nb += b[i]*b[i];
+	}
+	return sqrt(nr/nb);
+}
+
+int main() {
+	int failures = 0;
+	symildl::solver<double> solv;
+	symildl::solver_workspace<double> ws;
+	solv.set_message_level("none");
+	solv.set_solver("minres");
+	solv.set_solver_params(500, 1e-8);
+	solv.set_recycling(6);
+
+	const int sizes[] = {14, 11};
+	for (int m : sizes) {
+		vector<int> ptr, row;
+		vector<double> val;
+		laplacian(m, 0.7, ptr, row, val);
+		const int n = ptr.size() - 1;
+
+		solv.load(ptr, row, val);
+		solv.factor(2.0, 1e-2, 1.0);
+
+		vector<double> b(n), x;
+		const double* data[5] = {NULL};
+		for (int s = 0; s < 4; s++) {
+			for (int i = 0; i < n; i++) b[i] = 1.0 + 0.1*s*((i*7919 + s) % 13);
+			solv.solve(b, x, ws);
+
+			const double res = residual(ptr, row, val, b, x);
+			if (!(res < 1e-5)) {
+				printf("n = %d, solve %d: relative residual %g\n", n, s, res);
+				failures++;
+			}
+
+			// once the subspace is full, later solves reuse the same storage
+			if (ws.U.size() != 6) continue;
+			const double* now[5] = {ws.U[0].data(), ws.W[0].data(), ws.Z[0].data(), ws.BZ[0].data(), ws.V[0].data()};
+			if (data[0] != NULL && !std::equal(data, data + 5, now)) {
+				printf("n = %d, solve %d: the recycling vectors were reallocated\n", n, s);
+				failures++;
+			}
+			std::copy(now, now + 5, data);
+		}
+	}
+
+	// one workspace shared by two solvers: each must drop the other's subspace,
+	// whether or not the systems have the same size.
+	const int grids[][2] = {{10, 10}, {14, 10}};
+	for (int g = 0; g < 2; g++) {
+		symildl::solver<double> two[2];
+		vector<int> ptr[2], row[2];
+		vector<double> val[2];
+		for (int k = 0; k < 2; k++) {
+			laplacian(grids[g][k], 0.7 + 0.3*k, ptr[k], row[k], val[k]);
+			two[k].set_message_level("none");
+			two[k].set_solver("minres");
+			two[k].set_solver_params(500, 1e-8);
+			two[k].set_recycling(6);
+			two[k].load(ptr[k], row[k], val[k]);
+			two[k].factor(2.0, 1e-2, 1.0);
+		}
+
+		symildl::solver_workspace<double> shared;
+		for (int s = 0; s < 6; s++) {
+			const int k = s % 2, n = ptr[k].size() - 1;
+			vector<double> b(n, 1.0), x;
+			two[k].solve(b, x, shared);
+
+			const double res = residual(ptr[k], row[k], val[k], b, x);
+			if (!(res < 1e-5)) {
+				printf("shared workspace (grids %d and %d), solve %d: relative residual %g\n", grids[g][0], grids[g][1], s, res);
+				failures++;
+			}
+		}
+	}
+
+	printf("test_recycle: %s\n", (failures ? "FAILED" : "passed"));
+	return (failures ? 1 : 0);
+}
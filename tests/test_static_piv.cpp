@@ -0,0 +1,35 @@
+// Regression test for static pivoting: whether a 2x2 pivot is perturbed must not
+// depend on the scale of A.
+#include "solver.h"
+
+#include <cstdio>
+
+int main() {
+	int failures = 0;
+
+	// [0 1; 1 0] scaled by s is a perfectly conditioned 2x2 pivot at any scale.
+	// its determinant (-s^2) used to be compared with sqrt(eps)*s, so it was
+	// perturbed for small s.
+	const double scales[] = {1e-12, 1e-6, 1.0, 1e6};
+	for (double s : scales) {
+		vector<int> ptr = {0, 2, 3};
+		vector<int> row = {0, 1, 1};
+		vector<double> val = {0.0, s, 0.0};
+
+		symildl::solver<double> solv;
+		solv.set_message_level("none");
+		solv.set_equil("none");
+		solv.set_reorder_scheme("none");
+		solv.set_pivot("static");
+		solv.load(ptr, row, val);
+		solv.factor(2.0, 1e-3, 1.0);
+
+		if (solv.A.num_perturbed != 0) {
+			printf("scale %g: %d pivots perturbed\n", s, solv.A.num_perturbed);
+			failures++;
+		}
+	}
+
+	printf("test_static_piv: %s\n", (failures ? "FAILED" : "passed"));
+	return (failures ? 1 : 0);
+}
@@ -0,0 +1,33 @@
+// Regression test for lilc_matrix::sym_match(): the matching must pair both ways.
+#include "solver.h"
+
+#include <cstdio>
+
+int main() {
+	// the triangle 0-1-2 with a tiny diagonal at 0 and none at 1 and 2. 1 and 2
+	// are paired first, and the augmenting path from 0 must not pair 2 with 0
+	// (it used to, leaving mate = {1, 0, 0}).
+	vector<int> ptr = {0, 3, 4, 4};
+	vector<int> row = {0, 1, 2, 2};
+	vector<double> val = {0.1, 1.0, 1.0, 2.0};
+
+	lilc_matrix<double> A;
+	A.load(ptr, row, val);
+	A.sym_match();
+
+	int failures = 0;
+	for (int k = 0; k < A.n_cols(); k++) {
+		const int m = A.mate[k];
+		if (m != -1 && A.mate[m] != k) {
+			printf("mate[%d] = %d but mate[%d] = %d\n", k, m, m, A.mate[m]);
+			failures++;
+		}
+	}
+	if (A.mate[1] != 2 || A.mate[2] != 1 || A.mate[0] != -1) {
+		printf("expected mate = {-1, 2, 1}, got {%d, %d, %d}\n", A.mate[0], A.mate[1], A.mate[2]);
+		failures++;
+	}
+
+	printf("test_sym_match: %s\n", (failures ? "FAILED" : "passed"));
+	return (failures ? 1 : 0);
+}